@@ -62,6 +62,16 @@
 
 #define FUT_GCC_INSTRUMENT_KEYMASK  FUT_KEYMASK29
 
+/*  Changes the classes of events recorded by the FUT_PROBE macros */
+#define fut_keychange(how, mask, threadid) do {			\
+    if ((how) == FUT_ENABLE)						\
+      litl_write_set_keymask(__trace, __trace->keymask | (mask));	\
+    else if ((how) == FUT_DISABLE)					\
+      litl_write_set_keymask(__trace, __trace->keymask & ~(mask));	\
+    else if ((how) == FUT_SETMASK)					\
+      litl_write_set_keymask(__trace, (mask));			\
+  } while(0)
+
 /*  Fixed parameters of the fut coding scheme */
 #define FUT_GENERIC_EXIT_OFFSET     0x100   /* exit this much above entry */
 
@@ -32,6 +32,7 @@ static fxt_t __trace;
 /* BEGIN -- Recording functions */
 #define fut_setup(buffer_size, keymask, threadid) do {	\
     __trace = litl_write_init_trace(buffer_size);	\
+    litl_write_set_keymask(__trace, keymask);		\
     litl_write_pause_recording(__trace);		\
   }while(0)
 
@@ -70,53 +71,90 @@ static fxt_t __trace;
   do {							\
     litl_t*retval;					\
     litl_write_probe_pack_0(__trace, code, retval);	\
-    assert(retval != NULL);				\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   } while(0)
 
 #define FUT_DO_PROBE1(code, arg1)				\
   do {								\
     litl_t* retval;						\
     litl_write_probe_pack_1(__trace, code, arg1, retval);	\
-    assert(retval != NULL);					\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   }while(0)
 
 #define FUT_DO_PROBE2(code, arg1, arg2)				\
   do {								\
   litl_t *retval;						\
   litl_write_probe_pack_2(__trace, code, arg1, arg2, retval);	\
-  assert(retval != NULL);					\
+  assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
 }while(0)
 
 #define FUT_DO_PROBE3(code, arg1, arg2, arg3)				\
   do {									\
     litl_t *retval;							\
     litl_write_probe_pack_3(__trace, code, arg1, arg2, arg3, retval);	\
-    assert(retval != NULL);						\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   }while(0)
 
 #define FUT_DO_PROBE4(code, arg1, arg2, arg3, arg4)			\
   do {									\
     litl_t *retval;							\
     litl_write_probe_pack_4(__trace, code, arg1, arg2, arg3, arg4, retval); \
-    assert(retval != NULL);						\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   }while(0)
 
 #define FUT_DO_PROBE5(code, arg1, arg2, arg3, arg4, arg5)		\
   do {									\
     litl_t *retval;							\
     litl_write_probe_pack_5(__trace, code, arg1, arg2, arg3, arg4, arg5, retval); \
-    assert(retval != NULL);						\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   }while(0)
 
 #define FUT_DO_PROBE6(code, arg1, arg2, arg3, arg4, arg5, arg6)		\
   do {									\
     litl_t *retval;							\
     litl_write_probe_pack_6(__trace, code, arg1, arg2, arg3, arg4, arg5, arg6, retval); \
-    assert(retval != NULL);						\
+    assert(retval != NULL || litl_write_get_code_state(__trace, code) != LITL_CODE_ENABLED);	\
   }while(0)
 
 #define FUT_DO_PROBE(code, ...) litl_write_probe_pack_0(__trace, code);
 
+// the probes of a class of events are recorded only if their keymask is
+//   enabled
+#define FUT_PROBE0(mask, code) do {				\
+    if (__trace->keymask & (mask))				\
+      FUT_DO_PROBE0(code);					\
+  } while(0)
+
+#define FUT_PROBE1(mask, code, arg1) do {			\
+    if (__trace->keymask & (mask))				\
+      FUT_DO_PROBE1(code, arg1);				\
+  } while(0)
+
+#define FUT_PROBE2(mask, code, arg1, arg2) do {		\
+    if (__trace->keymask & (mask))				\
+      FUT_DO_PROBE2(code, arg1, arg2);				\
+  } while(0)
+
+#define FUT_PROBE3(mask, code, arg1, arg2, arg3) do {	\
+    if (__trace->keymask & (mask))				\
+      FUT_DO_PROBE3(code, arg1, arg2, arg3);			\
+  } while(0)
+
+#define FUT_PROBE4(mask, code, arg1, arg2, arg3, arg4) do {	\
+    if (__trace->keymask & (mask))				\
+      FUT_DO_PROBE4(code, arg1, arg2, arg3, arg4);		\
+  } while(0)
+
+#define FUT_PROBE5(mask, code, arg1, arg2, arg3, arg4, arg5) do {	\
+    if (__trace->keymask & (mask))					\
+      FUT_DO_PROBE5(code, arg1, arg2, arg3, arg4, arg5);		\
+  } while(0)
+
+#define FUT_PROBE6(mask, code, arg1, arg2, arg3, arg4, arg5, arg6) do { \
+    if (__trace->keymask & (mask))					\
+      FUT_DO_PROBE6(code, arg1, arg2, arg3, arg4, arg5, arg6);		\
+  } while(0)
+
 #define FUT_DO_PROBESTR(code, str) litl_write_probe_raw(__trace, code, strlen(str), str)
 
 /* END -- Events */
@@ -0,0 +1,290 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "litl_codec.h"
+
+/*
+ * The LZ codec encodes a sequence of literals followed by a match:
+ *   - a token: the number of literals (4 high bits) and the length of the
+ *     match minus LZ_MIN_MATCH (4 low bits). The value 15 means that the
+ *     length continues in the next Bytes: each Byte is added to the length
+ *     until a Byte is not 255;
+ *   - the literals;
+ *   - the distance to the match (2 Bytes, little endian).
+ * The last sequence only contains literals
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_DISTANCE 0xffff
+#define LZ_HASH_BITS 12
+// the last Bytes are always stored as literals
+#define LZ_LAST_LITERALS 5
+
+/*
+ * Reads 4 Bytes that may not be aligned
+ */
+static inline uint32_t __litl_lz_read32(const litl_data_t* src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+/*
+ * Returns the number of identical Bytes at the beginning of a and b, without
+ *   reading beyond a_end
+ */
+static inline litl_size_t __litl_lz_count(const litl_data_t* a,
+					  const litl_data_t* b,
+					  const litl_data_t* a_end) {
+  const litl_data_t* start = a;
+  uint64_t x, y;
+
+  while (a + sizeof(uint64_t) <= a_end) {
+    memcpy(&x, a, sizeof(x));
+    memcpy(&y, b, sizeof(y));
+    if (x != y) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      return a - start + (__builtin_ctzll(x ^ y) >> 3);
+#else
+      break;
+#endif
+    }
+    a += sizeof(uint64_t);
+    b += sizeof(uint64_t);
+  }
+  while (a < a_end && *a == *b) {
+    a++;
+    b++;
+  }
+  return a - start;
+}
+
+/*
+ * Returns the position of 4 Bytes in the hash table
+ */
+static inline uint32_t __litl_lz_hash(uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/*
+ * Writes the continuation of a length that does not fit in the token
+ */
+static litl_data_t* __litl_lz_write_length(litl_data_t* dst,
+					   litl_size_t length) {
+  while (length >= 255) {
+    *dst++ = 255;
+    length -= 255;
+  }
+  *dst++ = length;
+  return dst;
+}
+
+/*
+ * Writes a sequence of literals followed by a match. Returns NULL if it does
+ *   not fit before dst_end
+ */
+static litl_data_t* __litl_lz_write_sequence(litl_data_t* dst,
+					     litl_data_t* dst_end,
+					     const litl_data_t* literals,
+					     litl_size_t nb_literals,
+					     litl_size_t distance,
+					     litl_size_t match_length) {
+  litl_data_t* token;
+
+  // the token, the literals, the distance and the continuations of lengths
+  if ((litl_size_t) (dst_end - dst) < 1 + nb_literals + nb_literals / 255 + 1
+      + 2 + match_length / 255 + 1)
+    return NULL;
+
+  token = dst++;
+
+  *token = (nb_literals < 15 ? nb_literals : 15) << 4;
+  if (nb_literals >= 15)
+    dst = __litl_lz_write_length(dst, nb_literals - 15);
+  memcpy(dst, literals, nb_literals);
+  dst += nb_literals;
+
+  if (match_length > 0) {
+    *dst++ = distance & 0xff;
+    *dst++ = distance >> 8;
+    match_length -= LZ_MIN_MATCH;
+    *token |= match_length < 15 ? match_length : 15;
+    if (match_length >= 15)
+      dst = __litl_lz_write_length(dst, match_length - 15);
+  }
+
+  return dst;
+}
+
+/*
+ * Compresses a block with the LZ codec
+ */
+static litl_size_t __litl_lz_compress(const litl_data_t* src, litl_size_t size,
+				      litl_data_t* dst, litl_size_t capacity) {
+  uint32_t table[1 << LZ_HASH_BITS];
+  const litl_data_t* pos = src;
+  const litl_data_t* anchor = src;
+  const litl_data_t* end = src + size;
+  const litl_data_t* match_end = end - LZ_LAST_LITERALS;
+  litl_data_t* out = dst;
+  litl_data_t* out_end = dst + capacity;
+
+  memset(table, 0, sizeof(table));
+
+  while (size > LZ_MIN_MATCH + LZ_LAST_LITERALS
+      && pos + LZ_MIN_MATCH <= match_end) {
+    uint32_t sequence = __litl_lz_read32(pos);
+    uint32_t hash = __litl_lz_hash(sequence);
+    const litl_data_t* ref = src + table[hash];
+    table[hash] = pos - src;
+
+    if (ref >= pos || pos - ref > LZ_MAX_DISTANCE
+	|| __litl_lz_read32(ref) != sequence) {
+      // skip faster in data that does not compress
+      pos += 1 + ((pos - anchor) >> 6);
+      continue;
+    }
+
+    // extend the match
+    const litl_data_t* match = pos + LZ_MIN_MATCH;
+    match += __litl_lz_count(match, ref + LZ_MIN_MATCH, match_end);
+
+    out = __litl_lz_write_sequence(out, out_end, anchor, pos - anchor,
+				   pos - ref, match - pos);
+    if (!out)
+      return 0;
+
+    pos = match;
+    anchor = pos;
+  }
+
+  out = __litl_lz_write_sequence(out, out_end, anchor, end - anchor, 0, 0);
+  if (!out)
+    return 0;
+
+  return out - dst;
+}
+
+/*
+ * Reads the continuation of a length that does not fit in the token.
+ *   Returns NULL if the data is corrupted
+ */
+static const litl_data_t* __litl_lz_read_length(const litl_data_t* src,
+						const litl_data_t* src_end,
+						litl_size_t* length) {
+  litl_data_t byte;
+  do {
+    if (src >= src_end)
+      return NULL;
+    byte = *src++;
+    *length += byte;
+  } while (byte == 255);
+  return src;
+}
+
+/*
+ * Decompresses a block compressed with the LZ codec
+ */
+static litl_size_t __litl_lz_decompress(const litl_data_t* src,
+					litl_size_t size, litl_data_t* dst,
+					litl_size_t capacity) {
+  const litl_data_t* src_end = src + size;
+  litl_data_t* out = dst;
+  litl_data_t* out_end = dst + capacity;
+  litl_size_t length, distance;
+
+  while (src < src_end) {
+    litl_data_t token = *src++;
+
+    // copy the literals
+    length = token >> 4;
+    if (length == 15 && !(src = __litl_lz_read_length(src, src_end, &length)))
+      return 0;
+    if ((litl_size_t) (src_end - src) < length
+	|| (litl_size_t) (out_end - out) < length)
+      return 0;
+    memcpy(out, src, length);
+    src += length;
+    out += length;
+
+    // the last sequence does not contain any match
+    if (src == src_end)
+      break;
+
+    // copy the match, which may overlap the data it produces
+    if (src_end - src < 2)
+      return 0;
+    distance = src[0] | (src[1] << 8);
+    src += 2;
+    length = token & 15;
+    if (length == 15 && !(src = __litl_lz_read_length(src, src_end, &length)))
+      return 0;
+    length += LZ_MIN_MATCH;
+    if (distance == 0 || distance > (litl_size_t) (out - dst)
+	|| (litl_size_t) (out_end - out) < length)
+      return 0;
+
+    if (distance >= length) {
+      memcpy(out, out - distance, length);
+      out += length;
+    } else {
+      const litl_data_t* ref = out - distance;
+      while (length--)
+	*out++ = *ref++;
+    }
+  }
+
+  return out - dst;
+}
+
+const litl_codec_t litl_codec_lz = {
+  .id = LITL_CODEC_LZ,
+  .name = "lz",
+  .compress = __litl_lz_compress,
+  .decompress = __litl_lz_decompress
+};
+
+/*
+ * Registered codecs, indexed by their identifier
+ */
+static const litl_codec_t* __litl_codecs[256] = {
+  [LITL_CODEC_LZ] = &litl_codec_lz
+};
+
+/*
+ * Registers a user-defined codec
+ */
+int litl_codec_register(const litl_codec_t* codec) {
+  if (!codec || codec->id == LITL_CODEC_NONE || __litl_codecs[codec->id])
+    return -1;
+
+  __litl_codecs[codec->id] = codec;
+  return 0;
+}
+
+/*
+ * Returns a codec from its identifier
+ */
+const litl_codec_t* litl_codec_get(litl_data_t id) {
+  return __litl_codecs[id];
+}
+
+/*
+ * Returns a codec from its name
+ */
+const litl_codec_t* litl_codec_find(const char* name) {
+  int i;
+
+  for (i = 0; i < 256; i++)
+    if (__litl_codecs[i] && strcmp(__litl_codecs[i]->name, name) == 0)
+      return __litl_codecs[i];
+
+  return NULL;
+}
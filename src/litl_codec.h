@@ -0,0 +1,101 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+#ifndef LITL_CODEC_H_
+#define LITL_CODEC_H_
+
+/**
+ *  \file litl_codec.h
+ *  \brief litl_codec Provides the codecs that compress the blocks of events
+ *
+ *  \authors
+ *    Developers are : \n
+ *        Roman Iakymchuk   -- roman.iakymchuk@telecom-sudparis.eu \n
+ *        Francois Trahay   -- francois.trahay@telecom-sudparis.eu \n
+ */
+
+#include "litl_types.h"
+
+/**
+ * \defgroup litl_codec LiTL Compression Codecs
+ */
+
+/**
+ * \ingroup litl_codec
+ * \brief Identifier of the blocks that are stored without compression
+ */
+#define LITL_CODEC_NONE 0
+
+/**
+ * \ingroup litl_codec
+ * \brief Identifier of the built-in LZ codec
+ */
+#define LITL_CODEC_LZ 1
+
+/**
+ * \ingroup litl_codec
+ * \brief A callback function that compresses size Bytes of src into dst
+ * \return The size of the compressed data or 0 if it does not fit in
+ *  capacity Bytes
+ */
+typedef litl_size_t (*litl_compress_t)(const litl_data_t* src, litl_size_t size,
+				       litl_data_t* dst, litl_size_t capacity);
+
+/**
+ * \ingroup litl_codec
+ * \brief A callback function that decompresses size Bytes of src into dst
+ * \return The size of the decompressed data or 0 if the data is corrupted or
+ *  does not fit in capacity Bytes
+ */
+typedef litl_size_t (*litl_decompress_t)(const litl_data_t* src,
+					 litl_size_t size, litl_data_t* dst,
+					 litl_size_t capacity);
+
+/**
+ * \ingroup litl_codec
+ * \brief A compression codec. Its identifier is stored in each compressed
+ *  block, so the same codec has to be registered when the trace is read
+ */
+typedef struct litl_codec {
+  litl_data_t id; /**< An identifier of the codec (LITL_CODEC_*) */
+  const char* name; /**< A name of the codec */
+  litl_compress_t compress; /**< The compression function */
+  litl_decompress_t decompress; /**< The decompression function */
+} litl_codec_t;
+
+/**
+ * \ingroup litl_codec
+ * \brief The built-in LZ codec: a fast LZ77 codec that encodes literals and
+ *  matches of at least 4 Bytes within the last 64KB
+ */
+extern const litl_codec_t litl_codec_lz;
+
+/**
+ * \ingroup litl_codec
+ * \brief Registers a user-defined codec. It has to be called before the
+ *  trace is recorded or read
+ * \param codec A pointer to the codec
+ * \return Returns -1 if the identifier is already used. Otherwise, returns 0
+ */
+int litl_codec_register(const litl_codec_t* codec);
+
+/**
+ * \ingroup litl_codec
+ * \brief Returns a codec from its identifier
+ * \param id An identifier of the codec
+ * \return A pointer to the codec or NULL if it is not registered
+ */
+const litl_codec_t* litl_codec_get(litl_data_t id);
+
+/**
+ * \ingroup litl_codec
+ * \brief Returns a codec from its name
+ * \param name A name of the codec
+ * \return A pointer to the codec or NULL if it is not registered
+ */
+const litl_codec_t* litl_codec_find(const char* name);
+
+#endif /* LITL_CODEC_H_ */
@@ -5,12 +5,14 @@
  */
 
 #define _GNU_SOURCE
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include "litl_tools.h"
 #include "litl_merge.h"
 
 static litl_trace_merge_t* __arch;
@@ -68,6 +70,14 @@ static void __litl_merge_add_archive_header() {
     res = read(trace_in, header_buffer, general_header_size);
 
     nb_processes = ((litl_general_header_t *) header_buffer)->nb_processes;
+
+    // the process headers of older traces do not store the flags
+    if (!__litl_has_process_flags((litl_general_header_t *) header_buffer)) {
+      fprintf(stderr,
+              "[litl_merge] %s was recorded by an older version of LiTL and cannot be merged\n",
+              __arch->traces_names[trace_index]);
+      exit(EXIT_FAILURE);
+    }
     __triples[trace_index] = (litl_trace_triples_t *) malloc(
         nb_processes * sizeof(litl_trace_triples_t));
 
@@ -100,9 +110,19 @@ static void __litl_merge_add_archive_header() {
     }
 
     for (process_index = 0; process_index < nb_processes; process_index++) {
+      // the events of per-thread traces are stored outside of the trace file
+      if (((litl_process_header_t *) __arch->buffer)->flags
+          & LITL_FLAG_PER_THREAD_FILES) {
+        fprintf(stderr,
+                "[litl_merge] %s was recorded with per-thread files and cannot be merged\n",
+                __arch->traces_names[trace_index]);
+        exit(EXIT_FAILURE);
+      }
+
       __triples[trace_index][process_index].nb_processes = nb_processes;
       __triples[trace_index][process_index].position = global_header_size
-        + (process_index + 1) * process_header_size - sizeof(litl_offset_t);
+        + process_index * process_header_size
+        + offsetof(litl_process_header_t, offset);
       __triples[trace_index][process_index].offset =
         ((litl_process_header_t *) __arch->buffer)->offset - general_header_size
           - nb_processes * process_header_size;
@@ -4,6 +4,9 @@
  * See COPYING in top-level directory.
  */
 
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <math.h>
@@ -12,6 +15,7 @@
 #include <unistd.h>
 
 #include "litl_tools.h"
+#include "litl_codec.h"
 #include "litl_read.h"
 
 /*
@@ -20,7 +24,8 @@
 static void __litl_read_init_trace_header(litl_read_trace_t* trace) {
   int res;
 
-  litl_size_t header_size, general_header_size;
+  litl_size_t header_size, general_header_size, process_header_size;
+  litl_med_size_t process_index;
   general_header_size = sizeof(litl_general_header_t);
 
   // read the trace header
@@ -51,15 +56,33 @@ static void __litl_read_init_trace_header(litl_read_trace_t* trace) {
   trace->header_buffer_ptr = (litl_buffer_t) realloc(trace->header_buffer_ptr,
                                                      header_size);
 
+  // the process headers of the traces recorded by older versions of LiTL
+  //   end before the flags
+  trace->header = (litl_general_header_t *) trace->header_buffer_ptr;
+  if (__litl_has_process_flags(trace->header))
+    process_header_size = sizeof(litl_process_header_t);
+  else
+    process_header_size = offsetof(litl_process_header_t, flags);
+
   // read the trace header
   res = read(trace->f_handle, trace->header_buffer_ptr + general_header_size,
-             header_size - general_header_size);
+             trace->nb_processes * process_header_size);
   if (res == -1) {
     perror("Could not read the trace header!");
     exit(EXIT_FAILURE);
   }
   trace->header = (litl_general_header_t *) trace->header_buffer_ptr;
   trace->header_buffer = trace->header_buffer_ptr + general_header_size;
+
+  // move the older process headers in place, from the last one
+  if (process_header_size < sizeof(litl_process_header_t))
+    for (process_index = trace->nb_processes; process_index-- > 0;) {
+      litl_process_header_t* process_header =
+        (litl_process_header_t *) trace->header_buffer + process_index;
+      memmove(process_header, trace->header_buffer
+              + process_index * process_header_size, process_header_size);
+      process_header->flags = 0;
+    }
 }
 
 /*
@@ -113,6 +136,133 @@ static void __litl_read_next_pairs_buffer(litl_read_trace_t* trace,
   }
 }
 
+/*
+ * Reads the chunk of events of a thread that starts at offset in its trace
+ *   file. In compressed traces, the chunk is decompressed
+ */
+static void __litl_read_chunk(litl_read_process_t* process,
+                              litl_read_thread_t* thread,
+                              litl_offset_t offset) {
+  litl_block_header_t* block;
+  const litl_codec_t* codec;
+  int res;
+
+  lseek(thread->f_handle, offset, SEEK_SET);
+
+  if (!(process->header->flags & LITL_FLAG_COMPRESSED)) {
+    res = read(thread->f_handle, thread->buffer_ptr,
+               process->header->buffer_size);
+    if (res == -1) {
+      perror("Could not read the next part of the trace file!");
+      exit(EXIT_FAILURE);
+    }
+    return;
+  }
+
+  res = read(thread->f_handle, thread->block_ptr,
+             sizeof(litl_block_header_t) + process->header->buffer_size);
+  if (res == -1) {
+    perror("Could not read the next part of the trace file!");
+    exit(EXIT_FAILURE);
+  }
+
+  block = (litl_block_header_t *) thread->block_ptr;
+  if (res < (int) sizeof(litl_block_header_t)
+      || block->compressed_size > res - sizeof(litl_block_header_t)
+      || block->size > process->header->buffer_size
+      || block->size < sizeof(litl_offset_t)) {
+    fprintf(stderr, "[LiTL] A block of events is corrupted\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (block->codec == LITL_CODEC_NONE) {
+    memcpy(thread->buffer_ptr, thread->block_ptr + sizeof(litl_block_header_t),
+           block->size);
+  } else {
+    codec = litl_codec_get(block->codec);
+    if (!codec) {
+      fprintf(stderr, "[LiTL] Unknown codec %u: it has to be registered before reading the trace\n",
+              block->codec);
+      exit(EXIT_FAILURE);
+    }
+    if (codec->decompress(thread->block_ptr + sizeof(litl_block_header_t),
+                          block->compressed_size, thread->buffer_ptr,
+                          process->header->buffer_size) != block->size) {
+      fprintf(stderr, "[LiTL] A block of events is corrupted\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // the offset event at the end of the chunk points to the next chunk
+  *(litl_offset_t *) (thread->buffer_ptr + block->size
+                      - sizeof(litl_offset_t)) = block->offset;
+}
+
+/*
+ * Reads the thread of the footer index stored at position: its tid and the
+ *   offsets of its chunks. Returns the position of the next thread
+ */
+static litl_offset_t __litl_read_footer_thread(litl_read_trace_t* trace,
+                                               litl_read_thread_t* thread,
+                                               litl_offset_t position) {
+  litl_footer_thread_t footer_thread;
+  ssize_t size;
+
+  if (pread(trace->f_handle, &footer_thread, sizeof(litl_footer_thread_t),
+            position) != sizeof(litl_footer_thread_t)
+      || footer_thread.nb_chunks == 0) {
+    fprintf(stderr, "[LiTL] The footer index is corrupted\n");
+    exit(EXIT_FAILURE);
+  }
+  position += sizeof(litl_footer_thread_t);
+
+  size = footer_thread.nb_chunks * sizeof(litl_offset_t);
+  thread->chunks = (litl_offset_t *) malloc(size);
+  if (!thread->chunks) {
+    perror("Could not allocate memory for the footer index!");
+    exit(EXIT_FAILURE);
+  }
+  if (pread(trace->f_handle, thread->chunks, size, position) != size) {
+    fprintf(stderr, "[LiTL] The footer index is corrupted\n");
+    exit(EXIT_FAILURE);
+  }
+  thread->nb_chunks = footer_thread.nb_chunks;
+  thread->cur_chunk = 0;
+
+  thread->thread_pair->tid = footer_thread.tid;
+  thread->thread_pair->offset = thread->chunks[0];
+
+  return position + size;
+}
+
+static litl_read_event_t* __litl_read_next_thread_event(
+    litl_read_trace_t* trace, litl_read_process_t* process,
+    litl_read_thread_t* thread);
+
+/*
+ * Reads all the events of a thread to add its strings to the string table of
+ *   the process, and goes back to its first event. The raw events are then
+ *   rebuilt in any reading order
+ */
+static void __litl_read_scan_strings(litl_read_trace_t* trace,
+                                     litl_read_process_t* process,
+                                     litl_read_thread_t* thread) {
+  litl_offset_t offset = thread->thread_pair->offset;
+
+  while (__litl_read_next_thread_event(trace, process, thread))
+    ;
+
+  thread->thread_pair->offset = offset;
+  thread->cur_chunk = 0;
+  thread->time = 0;
+  thread->string_fragments_size = 0;
+  thread->cur_event.event = NULL;
+  __litl_read_chunk(process, thread, offset);
+  thread->buffer = thread->buffer_ptr;
+  thread->tracker = process->header->buffer_size;
+  thread->offset = 0;
+}
+
 /*
  * Initializes buffers -- one buffer per thread.
  */
@@ -120,6 +270,7 @@ static void __litl_read_init_threads(litl_read_trace_t* trace,
                                      litl_read_process_t* process) {
   litl_med_size_t thread_index, size;
   litl_thread_pair_t *thread_pair;
+  litl_offset_t footer_position = 0;
 
   size = sizeof(litl_thread_pair_t);
   // init nb_threads and allocate memory
@@ -127,8 +278,19 @@ static void __litl_read_init_threads(litl_read_trace_t* trace,
   process->threads = (litl_read_thread_t **) malloc(
       process->nb_threads * sizeof(litl_read_thread_t*));
 
-  // increase a bit the buffer size 'cause of the event's tail and the offset
+  // with the footer index, the only pair (tid, offset) points to the footer,
+  //   unless no chunk was written
+  if (process->header->flags & LITL_FLAG_FOOTER_INDEX) {
+    thread_pair = (litl_thread_pair_t *) process->header_buffer;
+    if (thread_pair->offset == 0)
+      process->nb_threads = 0;
+    footer_position = process->header->offset + thread_pair->offset;
+  }
+
+  // increase a bit the buffer size 'cause of the event's tail, the sampling
+  //   counters and the offset
   process->header->buffer_size += __litl_get_reg_event_size(LITL_MAX_PARAMS)
+    + LITL_MAX_SAMPLING_RULES * __litl_get_reg_event_size(5)
     + __litl_get_reg_event_size(0);
 
   for (thread_index = 0; thread_index < process->nb_threads; thread_index++) {
@@ -139,45 +301,90 @@ static void __litl_read_init_threads(litl_read_trace_t* trace,
         sizeof(litl_thread_pair_t));
     process->threads[thread_index]->buffer_ptr = (litl_buffer_t) malloc(
         process->header->buffer_size);
+    process->threads[thread_index]->f_handle = trace->f_handle;
+    process->threads[thread_index]->event_buffer = NULL;
+    process->threads[thread_index]->block_ptr = NULL;
+    process->threads[thread_index]->chunks = NULL;
+    process->threads[thread_index]->string_event = NULL;
+    process->threads[thread_index]->string_event_size = 0;
+    process->threads[thread_index]->string_fragments = NULL;
+    process->threads[thread_index]->string_fragments_size = 0;
+
+    if (process->header->flags & LITL_FLAG_FOOTER_INDEX) {
+      footer_position = __litl_read_footer_thread(
+          trace, process->threads[thread_index], footer_position);
+      thread_pair = process->threads[thread_index]->thread_pair;
+    } else {
+      // read pairs (tid, offset)
+      thread_pair = (litl_thread_pair_t *) process->header_buffer;
 
-    // read pairs (tid, offset)
-    thread_pair = (litl_thread_pair_t *) process->header_buffer;
+      // deal with slots of pairs
+      if ((thread_pair->tid == 0) && (thread_pair->offset != 0)) {
+        __litl_read_next_pairs_buffer(
+            trace, process, process->header->offset + thread_pair->offset);
+        thread_pair = (litl_thread_pair_t *) process->header_buffer;
+      }
 
-    // deal with slots of pairs
-    if ((thread_pair->tid == 0) && (thread_pair->offset != 0)) {
-      __litl_read_next_pairs_buffer(
-          trace, process, process->header->offset + thread_pair->offset);
-      thread_pair = (litl_thread_pair_t *) process->header_buffer;
+      // end of reading pairs
+      if ((thread_pair->tid == 0) && (thread_pair->offset == 0)) {
+        // the trace may list fewer threads than announced in its header
+        free(process->threads[thread_index]->thread_pair);
+        free(process->threads[thread_index]->buffer_ptr);
+        free(process->threads[thread_index]);
+        process->nb_threads = thread_index;
+        break;
+      }
+      process->header_buffer += size;
     }
 
-    // end of reading pairs
-    if ((thread_pair->tid == 0) && (thread_pair->offset == 0))
-      break;
-
     process->threads[thread_index]->thread_pair->tid = thread_pair->tid;
     // use two offsets: process and thread. Process offset for a position
     //  of thread pairs; thread offset for a position of events
     process->threads[thread_index]->thread_pair->offset = thread_pair->offset
       + process->header->offset;
 
+    // with per-thread files, the events of each thread are stored in
+    //   <trace file>.<thread index>
+    if (process->header->flags & LITL_FLAG_PER_THREAD_FILES) {
+      char* filename;
+      if (asprintf(&filename, "%s.%u", trace->filename, thread_index) == -1) {
+        perror("Could not set the name of the thread trace file!");
+        exit(EXIT_FAILURE);
+      }
+      if ((process->threads[thread_index]->f_handle = open(filename, O_RDONLY))
+          < 0) {
+        fprintf(stderr, "Cannot open %s\n", filename);
+        exit(EXIT_FAILURE);
+      }
+      free(filename);
+    }
+
+    // with delta-encoded timestamps or variable-length parameters, the
+    //   events are rebuilt in a separate buffer
+    if (process->header->flags
+        & (LITL_FLAG_DELTA_TIME | LITL_FLAG_VARINT_PARAMS)) {
+      process->threads[thread_index]->event_buffer = (litl_buffer_t) malloc(
+          process->header->buffer_size + LITL_DELTA_SHIFT);
+      process->threads[thread_index]->time = 0;
+    }
+
+    if (process->header->flags & LITL_FLAG_COMPRESSED)
+      process->threads[thread_index]->block_ptr = (litl_buffer_t) malloc(
+          sizeof(litl_block_header_t) + process->header->buffer_size);
+
     // read chunks of data
     // use offsets in order to access a chuck of data that corresponds to
     //   each thread
-    lseek(trace->f_handle, process->threads[thread_index]->thread_pair->offset,
-          SEEK_SET);
-    int res = read(trace->f_handle, process->threads[thread_index]->buffer_ptr,
-                   process->header->buffer_size);
-    if (res == -1) {
-      perror("Could not read the first partition of data from the trace file!");
-      exit(EXIT_FAILURE);
-    }
+    __litl_read_chunk(process, process->threads[thread_index],
+                      process->threads[thread_index]->thread_pair->offset);
 
     process->threads[thread_index]->buffer =
       process->threads[thread_index]->buffer_ptr;
     process->threads[thread_index]->tracker = process->header->buffer_size;
     process->threads[thread_index]->offset = 0;
 
-    process->header_buffer += size;
+    if (process->header->flags & LITL_FLAG_STRING_TABLE)
+      __litl_read_scan_strings(trace, process, process->threads[thread_index]);
   }
 }
 
@@ -193,6 +400,7 @@ litl_read_trace_t* litl_read_open_trace(const char* filename) {
     fprintf(stderr, "Cannot open %s\n", filename);
     exit(EXIT_FAILURE);
   }
+  trace->filename = strdup(filename);
 
   // init the trace header
   __litl_read_init_trace_header(trace);
@@ -223,6 +431,9 @@ void litl_read_init_processes(litl_read_trace_t* trace) {
 
     trace->processes[process_index]->cur_index = -1;
     trace->processes[process_index]->is_initialized = 0;
+    trace->processes[process_index]->strings = NULL;
+    trace->processes[process_index]->string_sizes = NULL;
+    trace->processes[process_index]->max_strings = 0;
 
     // init the process header
     __litl_read_init_process_header(trace, trace->processes[process_index]);
@@ -268,23 +479,13 @@ litl_size_t litl_read_get_buffer_size(litl_read_trace_t* trace) {
 /*
  * Reads a next portion of events from the trace file to the buffer
  */
-static void __litl_read_next_buffer(litl_read_trace_t* trace,
-                                    litl_read_process_t* process,
-				    litl_read_thread_t* thread) {
-  lseek(trace->f_handle,
-	process->header->offset
-        + thread->thread_pair->offset,
-	SEEK_SET);
-
+static void __litl_read_next_buffer(litl_read_process_t* process,
+                                    litl_read_thread_t* thread) {
   thread->offset = 0;
 
   // read portion of next events
-  int res = read(trace->f_handle, thread->buffer_ptr,
-                 process->header->buffer_size);
-  if (res == -1) {
-    perror("Could not read the next part of the trace file!");
-    exit(EXIT_FAILURE);
-  }
+  __litl_read_chunk(process, thread,
+                    process->header->offset + thread->thread_pair->offset);
 
   thread->buffer = thread->buffer_ptr;
   thread->tracker = thread ->offset + process->header->buffer_size;
@@ -301,6 +502,137 @@ void litl_read_reset_process(litl_read_process_t* process) {
       process->threads[thread_index]->buffer_ptr;
 }
 
+/*
+ * Rebuilds a regular event from an event with variable-length parameters.
+ *   The event may already be stored in the thread event buffer
+ */
+static litl_t* __litl_read_decode_varint(litl_read_thread_t* thread,
+                                         litl_t* event) {
+  litl_param_t params[LITL_MAX_PARAMS];
+  litl_data_t i, nb_params;
+  litl_buffer_t pos;
+  litl_t* decoded = (litl_t *) thread->event_buffer;
+
+  nb_params = event->parameters.varint.nb_params;
+  pos = event->parameters.varint.param;
+  for (i = 0; i < nb_params; i++)
+    pos = __litl_decode_varint(pos, &params[i]);
+
+  decoded->time = event->time;
+  decoded->code = event->code;
+  decoded->type = LITL_TYPE_REGULAR;
+  decoded->parameters.regular.nb_params = nb_params;
+  memcpy(decoded->parameters.regular.param, params,
+         nb_params * sizeof(litl_param_t));
+
+  return decoded;
+}
+
+/*
+ * Adds the string recorded by an event to the string table of the process.
+ *   The fragments of a string that does not fit in a buffer are gathered
+ *   until its end
+ */
+static void __litl_read_add_string(litl_read_process_t* process,
+                                   litl_read_thread_t* thread, litl_t* event) {
+  litl_buffer_t data = event->parameters.packed.param;
+  litl_size_t size = event->parameters.packed.size;
+  litl_string_id_t id, max_strings;
+
+  if (event->type == LITL_TYPE_FRAGMENT || thread->string_fragments_size) {
+    thread->string_fragments = (litl_buffer_t) realloc(
+        thread->string_fragments, thread->string_fragments_size + size);
+    if (!thread->string_fragments) {
+      perror("Could not allocate memory for a string of the string table!");
+      exit(EXIT_FAILURE);
+    }
+    memcpy(thread->string_fragments + thread->string_fragments_size, data,
+           size);
+    thread->string_fragments_size += size;
+    if (event->type == LITL_TYPE_FRAGMENT)
+      return;
+
+    data = thread->string_fragments;
+    size = thread->string_fragments_size;
+    thread->string_fragments_size = 0;
+  }
+
+  if (size < sizeof(litl_string_id_t))
+    return;
+  memcpy(&id, data, sizeof(litl_string_id_t));
+  data += sizeof(litl_string_id_t);
+  size -= sizeof(litl_string_id_t);
+
+  if (id >= process->max_strings) {
+    max_strings = 2 * id;
+    process->strings = (litl_buffer_t *) realloc(
+        process->strings, max_strings * sizeof(litl_buffer_t));
+    process->string_sizes = (litl_size_t *) realloc(
+        process->string_sizes, max_strings * sizeof(litl_size_t));
+    if (!process->strings || !process->string_sizes) {
+      perror("Could not allocate memory for the string table!");
+      exit(EXIT_FAILURE);
+    }
+    memset(process->strings + process->max_strings, 0,
+           (max_strings - process->max_strings) * sizeof(litl_buffer_t));
+    process->max_strings = max_strings;
+  }
+
+  // a string may be recorded again, e.g. after the recording was paused
+  free(process->strings[id]);
+  process->strings[id] = (litl_buffer_t) malloc(size);
+  if (!process->strings[id]) {
+    perror("Could not allocate memory for a string of the string table!");
+    exit(EXIT_FAILURE);
+  }
+  memcpy(process->strings[id], data, size);
+  process->string_sizes[id] = size;
+}
+
+/*
+ * Rebuilds the current event of a thread as a raw event if it carries the id
+ *   of its data. The strings of all the threads are read when the process is
+ *   initialized. The event is left as it is if its string is not in the trace
+ */
+static void __litl_read_resolve_string(litl_read_process_t* process,
+                                       litl_read_thread_t* thread) {
+  litl_t* event = thread->cur_event.event;
+  litl_string_id_t id;
+  litl_size_t size, event_size;
+  litl_t* decoded;
+
+  if (!(process->header->flags & LITL_FLAG_STRING_TABLE) || !event
+      || event->type != LITL_TYPE_STRING)
+    return;
+
+  id = event->parameters.string.id;
+  if (id >= process->max_strings || !process->strings[id])
+    return;
+
+  // the raw data end with a null character
+  size = process->string_sizes[id];
+  event_size = __litl_get_event_size(LITL_TYPE_RAW, size + 1);
+  if (thread->string_event_size < event_size) {
+    free(thread->string_event);
+    thread->string_event = (litl_buffer_t) malloc(event_size);
+    if (!thread->string_event) {
+      perror("Could not allocate memory for a raw event!");
+      exit(EXIT_FAILURE);
+    }
+    thread->string_event_size = event_size;
+  }
+
+  decoded = (litl_t *) thread->string_event;
+  decoded->time = event->time;
+  decoded->code = event->code;
+  decoded->type = LITL_TYPE_RAW;
+  decoded->parameters.raw.size = size + 1;
+  memcpy(decoded->parameters.raw.data, process->strings[id], size);
+  decoded->parameters.raw.data[size] = '\0';
+
+  thread->cur_event.event = decoded;
+}
+
 /*
  * Reads an event
  */
@@ -311,6 +643,7 @@ static litl_read_event_t* __litl_read_next_thread_event(
   litl_data_t to_be_loaded;
   litl_t* event;
   litl_buffer_t buffer;
+  litl_size_t shift;
 
   buffer = thread->buffer;
   to_be_loaded = 0;
@@ -320,7 +653,11 @@ static litl_read_event_t* __litl_read_next_thread_event(
     return NULL ;
   }
 
-  event = (litl_t *) buffer;
+  // with delta-encoded timestamps, the events are stored without their
+  //   first bytes. Only the fields that follow the time are read in place
+  shift = (process->header->flags & LITL_FLAG_DELTA_TIME) ?
+    LITL_DELTA_SHIFT : 0;
+  event = (litl_t *) (buffer - shift);
 
   // While reading events from the buffer, there can be two situations:
   // 1. The situation when the buffer contains exact number of events;
@@ -331,27 +668,36 @@ static litl_read_event_t* __litl_read_next_thread_event(
   // If any of these cases is not true, the next part of the trace plus
   // the current event is loaded to the buffer
   litl_size_t remaining_size = thread->tracker - thread->offset;
-  if (remaining_size < __litl_get_reg_event_size(0)) {
+  if (remaining_size < __litl_get_reg_event_size(0) - shift) {
     // this event is truncated. We can't even read the nb_param field
     to_be_loaded = 1;
   } else {
     // The nb_param (or size) field is available. Let's check whether
     //   the event is truncated
-    litl_med_size_t event_size = __litl_get_gen_event_size(event);
+    litl_med_size_t event_size = __litl_get_gen_event_size(event) - shift;
     if (remaining_size < event_size)
       to_be_loaded = 1;
   }
 
   // fetch the next block of data from the trace
   if (to_be_loaded) {
-    __litl_read_next_buffer(trace, process, thread);
+    __litl_read_next_buffer(process, thread);
     buffer = thread->buffer;
-    event = (litl_t *) buffer;
+    event = (litl_t *) (buffer - shift);
   }
   to_be_loaded = 0;
 
-  // event that stores tid and offset
-  if (event->code == LITL_OFFSET_CODE) {
+  // event that stores tid and offset. With the footer index, the next chunk
+  //   is the next one of the index
+  if (event->code == LITL_OFFSET_CODE && thread->chunks) {
+    if (++thread->cur_chunk < thread->nb_chunks) {
+      thread->thread_pair->offset = thread->chunks[thread->cur_chunk];
+      to_be_loaded = 1;
+    } else {
+      thread->cur_event.event = NULL;
+      return NULL ;
+    }
+  } else if (event->code == LITL_OFFSET_CODE) {
     if (event->parameters.offset.offset != 0) {
       thread->thread_pair->offset = event->parameters.offset.offset;
       to_be_loaded = 1;
@@ -362,18 +708,44 @@ static litl_read_event_t* __litl_read_next_thread_event(
     }
   }
 
-  // fetch the next block of data from the trace
+  // fetch the next block of data from the trace. It may hold nothing but its
+  //   offset event
   if (to_be_loaded) {
-    __litl_read_next_buffer(trace, process, thread);
-    buffer = thread->buffer;
-    event = (litl_t *) buffer;
+    __litl_read_next_buffer(process, thread);
+    return __litl_read_next_thread_event(trace, process, thread);
   }
 
   // move pointer to the next event and update __offset
-  litl_med_size_t evt_size = __litl_get_gen_event_size(event);
+  litl_med_size_t evt_size = __litl_get_gen_event_size(event) - shift;
   thread->buffer += evt_size;
   thread->offset += evt_size;
 
+  if (shift) {
+    if (event->type == LITL_TYPE_TIME) {
+      // the time synchronization event is followed by a regular event
+      thread->time = event->parameters.time.time;
+      return __litl_read_next_thread_event(trace, process, thread);
+    }
+
+    // rebuild the event with its full time
+    thread->time += *(litl_time_delta_t *) buffer;
+    memcpy(thread->event_buffer + shift, buffer, evt_size);
+    event = (litl_t *) thread->event_buffer;
+    event->time = thread->time;
+  }
+
+  if (event->type == LITL_TYPE_VARINT)
+    event = __litl_read_decode_varint(thread, event);
+
+  // the events that add strings to the string table are not returned
+  if ((process->header->flags & LITL_FLAG_STRING_TABLE)
+      && event->code == LITL_STRING_CODE
+      && (event->type == LITL_TYPE_PACKED
+          || event->type == LITL_TYPE_FRAGMENT)) {
+    __litl_read_add_string(process, thread, event);
+    return __litl_read_next_thread_event(trace, process, thread);
+  }
+
   thread->cur_event.event = event;
   thread->cur_event.tid = thread->thread_pair->tid;
 
@@ -383,7 +755,12 @@ static litl_read_event_t* __litl_read_next_thread_event(
 litl_read_event_t* litl_read_next_thread_event(litl_read_trace_t* trace,
 					       litl_read_process_t* process,
 					       litl_read_thread_t* thread) {
-  return __litl_read_next_thread_event(trace, process, thread);
+  litl_read_event_t* event;
+
+  event = __litl_read_next_thread_event(trace, process, thread);
+  if (event)
+    __litl_read_resolve_string(process, thread);
+  return event;
 }
 
 
@@ -420,8 +797,10 @@ litl_read_event_t* litl_read_next_process_event(litl_read_trace_t* trace,
       }
     }
 
-  if (found)
+  if (found) {
+    __litl_read_resolve_string(process, process->threads[process->cur_index]);
     return LITL_READ_GET_CUR_EVENT(process);
+  }
 
   return NULL ;
 }
@@ -450,10 +829,7 @@ litl_read_event_t* litl_read_next_event(litl_read_trace_t* trace) {
  */
 void litl_read_finalize_trace(litl_read_trace_t* trace) {
   litl_med_size_t process_index, thread_index;
-
-  // close the file
-  close(trace->f_handle);
-  trace->f_handle = -1;
+  litl_string_id_t string_id;
 
   // free traces
   for (process_index = 0; process_index < trace->nb_processes;
@@ -462,17 +838,36 @@ void litl_read_finalize_trace(litl_read_trace_t* trace) {
     for (thread_index = 0;
         thread_index < trace->processes[process_index]->nb_threads;
         thread_index++) {
+      // close the thread-specific trace file
+      if (trace->processes[process_index]->threads[thread_index]->f_handle
+          != trace->f_handle)
+        close(trace->processes[process_index]->threads[thread_index]->f_handle);
       free(trace->processes[process_index]->threads[thread_index]->thread_pair);
       free(trace->processes[process_index]->threads[thread_index]->buffer_ptr);
+      free(trace->processes[process_index]->threads[thread_index]->event_buffer);
+      free(trace->processes[process_index]->threads[thread_index]->block_ptr);
+      free(trace->processes[process_index]->threads[thread_index]->chunks);
+      free(trace->processes[process_index]->threads[thread_index]->string_event);
+      free(trace->processes[process_index]->threads[thread_index]->string_fragments);
       free(trace->processes[process_index]->threads[thread_index]);
     }
 
+    for (string_id = 0; string_id < trace->processes[process_index]->max_strings;
+        string_id++)
+      free(trace->processes[process_index]->strings[string_id]);
+    free(trace->processes[process_index]->strings);
+    free(trace->processes[process_index]->string_sizes);
     free(trace->processes[process_index]->threads);
     free(trace->processes[process_index]->header_buffer_ptr);
     free(trace->processes[process_index]);
   }
 
+  // close the file
+  close(trace->f_handle);
+  trace->f_handle = -1;
+
   // free a trace structure
+  free(trace->filename);
   free(trace->processes);
   free(trace->header_buffer_ptr);
   free(trace);
@@ -187,7 +187,7 @@ void litl_read_finalize_trace(litl_read_trace_t* trace);
  */
 #define __LITL_READ_GET_ARG_REGULAR(_ptr_, arg) do {	\
     arg = (typeof(arg)) *(litl_param_t*)_ptr_;		\
-    (litl_param_t*)_ptr_++;				\
+    _ptr_ = ((litl_param_t*)_ptr_) + 1;			\
   } while(0)
 
 /*
@@ -266,6 +266,13 @@ void litl_read_finalize_trace(litl_read_trace_t* trace);
  * \param read_event An event
  */
 #define LITL_READ_OFFSET(read_event) (&(read_event)->event->parameters.offset)
+/**
+ * \ingroup litl_read_process
+ * \brief Returns the string id of a raw event whose string was not read
+ *  (LITL_TYPE_STRING)
+ * \param read_event An event
+ */
+#define LITL_READ_STRING(read_event) (&(read_event)->event->parameters.string)
 
 /**
  * \ingroup litl_read_process
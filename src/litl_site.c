@@ -0,0 +1,385 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/membarrier.h>
+#endif
+
+#include "litl_site.h"
+
+/*
+ * Defines the maximum number of modules (the executable and shared
+ *   libraries) with probe sites
+ */
+#define LITL_SITE_MAX_MODULES 64
+
+/*
+ * The probe sites and the branches of a module
+ */
+typedef struct {
+  litl_site_t* sites;
+  litl_site_t* sites_end;
+  litl_site_jump_t* jumps;
+  litl_site_jump_t* jumps_end;
+} litl_site_module_t;
+
+static litl_site_module_t __litl_site_modules[LITL_SITE_MAX_MODULES];
+static int __litl_site_nb_modules = 0;
+
+// serializes the changes of the sites, and thus the patching of the code
+static pthread_mutex_t __litl_site_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef LITL_SITE_PATCHABLE
+static const litl_data_t __litl_site_nop[5] = { 0x0f, 0x1f, 0x44, 0x00, 0x00 };
+
+/*
+ * A branch being patched and its new instruction
+ */
+typedef struct {
+  litl_site_jump_t* jump;
+  litl_data_t insn[5];
+} litl_site_patch_t;
+
+static struct sigaction __litl_site_old_sigtrap;
+static int __litl_site_is_sigtrap_installed = 0;
+static int __litl_site_is_fallback_reported = 0;
+
+/*
+ * Fills the instruction of a branch: a jump to the code of the site when it
+ *   is enabled, a 5-Byte nop otherwise
+ */
+static void __litl_site_get_insn(litl_site_jump_t* jump, litl_data_t is_enabled,
+				 litl_data_t insn[5]) {
+  if (is_enabled) {
+    int32_t distance = jump->target - (jump->code + 5);
+    insn[0] = 0xe9;
+    memcpy(&insn[1], &distance, sizeof(distance));
+  } else
+    memcpy(insn, __litl_site_nop, 5);
+}
+
+/*
+ * Handles the int3 that a thread hits while a branch is patched: the thread
+ *   continues as if the new instruction were already written. The other
+ *   traps are handed over to the previous handler
+ */
+static void __litl_site_sigtrap(int sig, siginfo_t* info, void* context) {
+  ucontext_t* uc = (ucontext_t*) context;
+  uintptr_t code = uc->uc_mcontext.gregs[REG_RIP] - 1;
+  litl_site_jump_t* jump;
+  int i, nb_modules;
+
+  if (info->si_code == SI_KERNEL) {
+    // the int3 was replaced meanwhile: execute the new instruction
+    if (*(volatile litl_data_t*) code != 0xcc) {
+      uc->uc_mcontext.gregs[REG_RIP] = code;
+      return;
+    }
+
+    nb_modules = __atomic_load_n(&__litl_site_nb_modules, __ATOMIC_ACQUIRE);
+    for (i = 0; i < nb_modules; i++)
+      for (jump = __litl_site_modules[i].jumps;
+	   jump && jump < __litl_site_modules[i].jumps_end; jump++)
+	if (jump->code == code) {
+	  uc->uc_mcontext.gregs[REG_RIP] =
+	    __atomic_load_n(&jump->site->is_enabled, __ATOMIC_RELAXED) ?
+	      jump->target : code + 5;
+	  return;
+	}
+  }
+
+  if (__litl_site_old_sigtrap.sa_flags & SA_SIGINFO)
+    __litl_site_old_sigtrap.sa_sigaction(sig, info, context);
+  else if (__litl_site_old_sigtrap.sa_handler == SIG_DFL) {
+    // the default action applies once the handler returns
+    sigaction(SIGTRAP, &__litl_site_old_sigtrap, NULL);
+    raise(SIGTRAP);
+  } else if (__litl_site_old_sigtrap.sa_handler != SIG_IGN)
+    __litl_site_old_sigtrap.sa_handler(sig);
+}
+
+/*
+ * Serializes the instruction stream of all the threads of the process, so
+ *   that they see the modified code. Without membarrier, changing the
+ *   protection of a page makes the kernel interrupt the CPUs that run the
+ *   threads to flush their TLB, which serializes them too
+ */
+static void __litl_site_sync_cores() {
+  static litl_data_t page[4096] __attribute__ ((aligned(4096)));
+#ifdef MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE
+  static int is_registered = 0;
+
+  if (is_registered == 0)
+    is_registered = syscall(__NR_membarrier,
+			    MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_SYNC_CORE,
+			    0) == 0 ? 1 : -1;
+  if (is_registered == 1
+      && syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED_SYNC_CORE,
+		 0) == 0)
+    return;
+#endif
+  page[0]++;
+  mprotect(page, sizeof(page), PROT_READ);
+  mprotect(page, sizeof(page), PROT_READ | PROT_WRITE);
+}
+
+/*
+ * Makes the page of a branch writable or not. Returns -1 if it fails
+ */
+static int __litl_site_protect(litl_site_jump_t* jump, int prot) {
+  uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  return mprotect((void*) (jump->code & ~(page_size - 1)), page_size, prot);
+}
+#endif
+
+/*
+ * Patches the branches that do not match the state of their site, like
+ *   text_poke_bp in Linux: the first Byte of each branch is replaced by an
+ *   int3, then the last 4 Bytes, then the first one, and the threads are
+ *   serialized after each step. A thread that hits an int3 meanwhile is
+ *   handled by __litl_site_sigtrap. If the code cannot be made writable, a
+ *   branch that was never patched keeps checking the flag of its site, and a
+ *   site whose patched branch cannot change keeps its state. Returns -1 if a
+ *   branch could not be patched
+ */
+static int __litl_site_sync_jumps(litl_site_module_t* module) {
+  int retval = 0;
+#ifdef LITL_SITE_PATCHABLE
+  litl_site_jump_t* jump;
+  litl_site_patch_t* patches;
+  litl_data_t insn[5], is_jump;
+  int i, nb_patches = 0;
+
+  if (!module->jumps || module->jumps == module->jumps_end)
+    return 0;
+
+  if (!__litl_site_is_sigtrap_installed) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = __litl_site_sigtrap;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGTRAP, &action, &__litl_site_old_sigtrap) != 0) {
+      fprintf(stderr, "[LiTL] Warning: cannot patch the probe sites without a SIGTRAP handler\n");
+      return -1;
+    }
+    __litl_site_is_sigtrap_installed = 1;
+  }
+
+  patches = malloc((module->jumps_end - module->jumps)
+		   * sizeof(litl_site_patch_t));
+  if (!patches) {
+    perror("Could not allocate memory for patching the probe sites!");
+    exit(EXIT_FAILURE);
+  }
+
+  for (jump = module->jumps; jump < module->jumps_end; jump++) {
+    __litl_site_get_insn(jump, jump->site->is_enabled, insn);
+    if (memcmp((void*) jump->code, insn, sizeof(insn)) == 0)
+      continue;
+
+    if (__litl_site_protect(jump, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+      __litl_site_get_insn(jump, 1, insn);
+      is_jump = memcmp((void*) jump->code, insn, sizeof(insn)) == 0;
+      if (is_jump || memcmp((void*) jump->code, __litl_site_nop, 5) == 0) {
+	// the site keeps the state of its patched branch
+	fprintf(stderr, "[LiTL] Warning: cannot patch the probe site %s:%d\n",
+		jump->site->file, jump->site->line);
+	__atomic_store_n(&jump->site->is_enabled, is_jump, __ATOMIC_RELAXED);
+	retval = -1;
+      } else if (!__litl_site_is_fallback_reported) {
+	fprintf(stderr, "[LiTL] Warning: cannot patch the probe sites, they check their flag instead\n");
+	__litl_site_is_fallback_reported = 1;
+      }
+      continue;
+    }
+
+    patches[nb_patches].jump = jump;
+    memcpy(patches[nb_patches++].insn, insn, sizeof(insn));
+    __atomic_store_n((litl_data_t*) jump->code, 0xcc, __ATOMIC_RELAXED);
+  }
+
+  if (nb_patches > 0) {
+    __litl_site_sync_cores();
+    for (i = 0; i < nb_patches; i++)
+      memcpy((litl_data_t*) patches[i].jump->code + 1, &patches[i].insn[1], 4);
+    __litl_site_sync_cores();
+    for (i = 0; i < nb_patches; i++)
+      __atomic_store_n((litl_data_t*) patches[i].jump->code,
+		       patches[i].insn[0], __ATOMIC_RELAXED);
+    __litl_site_sync_cores();
+
+    for (i = 0; i < nb_patches; i++)
+      __litl_site_protect(patches[i].jump, PROT_READ | PROT_EXEC);
+  }
+  free(patches);
+#else
+  (void) module;
+#endif
+  return retval;
+}
+
+/*
+ * Enables or disables the sites of a group in all the modules. Returns the
+ *   number of sites in the group, or -1 if a site could not be patched
+ */
+static int __litl_site_set_group(const char* group, litl_data_t is_enabled) {
+  int i, nb_sites = 0, res = 0;
+  litl_site_t* site;
+
+  pthread_mutex_lock(&__litl_site_lock);
+  for (i = 0; i < __litl_site_nb_modules; i++) {
+    litl_site_module_t* module = &__litl_site_modules[i];
+
+    for (site = module->sites; site < module->sites_end; site++)
+      if (!group || strcmp(site->group, group) == 0) {
+	__atomic_store_n(&site->is_enabled, is_enabled, __ATOMIC_RELAXED);
+	nb_sites++;
+      }
+    if (__litl_site_sync_jumps(module) != 0)
+      res = -1;
+  }
+  pthread_mutex_unlock(&__litl_site_lock);
+
+  return res ? res : nb_sites;
+}
+
+/*
+ * Enables or disables one site. Returns -1 if the site could not be patched
+ */
+static int __litl_site_set(litl_site_t* site, litl_data_t is_enabled) {
+  int i, res = 0;
+
+  pthread_mutex_lock(&__litl_site_lock);
+  __atomic_store_n(&site->is_enabled, is_enabled, __ATOMIC_RELAXED);
+  for (i = 0; i < __litl_site_nb_modules; i++)
+    if (site >= __litl_site_modules[i].sites
+	&& site < __litl_site_modules[i].sites_end
+	&& __litl_site_sync_jumps(&__litl_site_modules[i]) != 0)
+      res = -1;
+  pthread_mutex_unlock(&__litl_site_lock);
+
+  return res;
+}
+
+/*
+ * Enables a probe site
+ */
+int litl_site_enable(litl_site_t* site) {
+  return __litl_site_set(site, 1);
+}
+
+/*
+ * Disables a probe site
+ */
+int litl_site_disable(litl_site_t* site) {
+  return __litl_site_set(site, 0);
+}
+
+/*
+ * Enables all the probe sites of a group
+ */
+int litl_site_enable_group(const char* group) {
+  return __litl_site_set_group(group, 1);
+}
+
+/*
+ * Disables all the probe sites of a group
+ */
+int litl_site_disable_group(const char* group) {
+  return __litl_site_set_group(group, 0);
+}
+
+/*
+ * Checks whether a group is listed in a comma-separated list of groups
+ */
+static int __litl_site_is_listed(const char* list, const char* group) {
+  size_t length = strlen(group);
+
+  while (*list) {
+    const char* end = strchr(list, ',');
+    if (!end)
+      end = list + strlen(list);
+    if (((size_t) (end - list) == length && strncmp(list, group, length) == 0)
+	|| ((end - list) == 3 && strncmp(list, "all", 3) == 0))
+      return 1;
+    list = *end ? end + 1 : end;
+  }
+  return 0;
+}
+
+/*
+ * Registers the probe sites of a module
+ */
+void __litl_site_register(litl_site_t* sites, litl_site_t* sites_end,
+			  litl_site_jump_t* jumps, litl_site_jump_t* jumps_end) {
+  int i;
+  litl_site_t* site;
+  char* str = getenv("LITL_SITES");
+
+  pthread_mutex_lock(&__litl_site_lock);
+
+  // the registration function is called by each file of the module
+  for (i = 0; i < __litl_site_nb_modules; i++)
+    if (__litl_site_modules[i].sites == sites)
+      goto out;
+
+  if (__litl_site_nb_modules == LITL_SITE_MAX_MODULES) {
+    fprintf(stderr, "[LiTL] Warning: too many modules with probe sites\n");
+    goto out;
+  }
+
+  // the module is published once it is complete, for __litl_site_sigtrap
+  litl_site_module_t* module = &__litl_site_modules[__litl_site_nb_modules];
+  module->sites = sites;
+  module->sites_end = sites_end;
+  module->jumps = jumps;
+  module->jumps_end = jumps_end;
+  __atomic_store_n(&__litl_site_nb_modules, __litl_site_nb_modules + 1,
+		   __ATOMIC_RELEASE);
+
+  // enable the groups listed in the environment variable, and replace the
+  //   initial branches to the flag checks
+  if (str)
+    for (site = sites; site < sites_end; site++)
+      if (__litl_site_is_listed(str, site->group))
+	site->is_enabled = 1;
+  __litl_site_sync_jumps(module);
+
+  out: pthread_mutex_unlock(&__litl_site_lock);
+}
+
+/*
+ * Unregisters the probe sites of a module before it is unloaded
+ */
+void __litl_site_unregister(litl_site_t* sites) {
+  int i;
+
+  pthread_mutex_lock(&__litl_site_lock);
+
+  // the unregistration function is called by each file of the module. The
+  //   branches are only patched while the lock is held, so
+  //   __litl_site_sigtrap does not read the modules meanwhile
+  for (i = 0; i < __litl_site_nb_modules; i++)
+    if (__litl_site_modules[i].sites == sites) {
+      __litl_site_modules[i] = __litl_site_modules[__litl_site_nb_modules - 1];
+      __atomic_store_n(&__litl_site_nb_modules, __litl_site_nb_modules - 1,
+		       __ATOMIC_RELEASE);
+      break;
+    }
+
+  pthread_mutex_unlock(&__litl_site_lock);
+}
@@ -0,0 +1,196 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+#ifndef LITL_SITE_H_
+#define LITL_SITE_H_
+
+/**
+ *  \file litl_site.h
+ *  \brief litl_site Provides probe sites that can be enabled and disabled
+ *  individually or by group at runtime, and that cost almost nothing when
+ *  they are disabled
+ *
+ *  \authors
+ *    Developers are : \n
+ *        Roman Iakymchuk   -- roman.iakymchuk@telecom-sudparis.eu \n
+ *        Francois Trahay   -- francois.trahay@telecom-sudparis.eu \n
+ */
+
+#include <stdint.h>
+
+#include "litl_types.h"
+
+/**
+ * \defgroup litl_site LiTL Probe Sites
+ */
+
+/**
+ * \ingroup litl_site
+ * \brief A probe site. Each LITL_SITE call site defines one in the litl_sites
+ *  section of its module
+ */
+typedef struct litl_site {
+  const char* group; /**< A name of the group of the site */
+  const char* file; /**< A source file of the site */
+  int line; /**< A line of the site in its source file */
+  litl_data_t is_enabled; /**< Indicates whether the site is enabled (1) or not (0). By default, it is disabled */
+} litl_site_t;
+
+/**
+ * \ingroup litl_site
+ * \brief A patchable branch of a probe site, stored in the litl_site_jumps
+ *  section. The compiler may duplicate a site, so a site may have several
+ *  branches
+ */
+typedef struct {
+  uintptr_t code; /**< An address of the 5-Byte instruction to patch */
+  uintptr_t target; /**< An address of the code of the enabled site */
+  litl_site_t* site; /**< A pointer to the site */
+} litl_site_jump_t;
+
+#if defined(__x86_64__) && !defined(LITL_SITE_NO_PATCH)
+/**
+ * \ingroup litl_site
+ * \brief Defined when the probe sites are self-patching branches: a disabled
+ *  site is a 5-Byte nop that is replaced by a jump when it is enabled. Until
+ *  its module is registered, or if its code cannot be made writable, the
+ *  branch jumps to a check of the flag of the site. Otherwise, or if
+ *  LITL_SITE_NO_PATCH is defined, each site loads its flag
+ */
+#define LITL_SITE_PATCHABLE 1
+#endif
+
+#ifdef LITL_SITE_PATCHABLE
+/**
+ * \ingroup litl_site
+ * \brief Executes a statement, e.g. a probe, only when the site is enabled.
+ *  The statement must not jump out of the site with break or continue
+ * \param group A name of the group of the site (a string literal)
+ * \param statement A statement to execute when the site is enabled
+ */
+#define LITL_SITE(group, statement) do {				\
+    __label__ __litl_site_check, __litl_site_enabled;			\
+    static litl_site_t __litl_site					\
+      __attribute__ ((section("litl_sites"), used, aligned(8))) =	\
+      { group, __FILE__, __LINE__, 0 };					\
+    asm goto (".balign 8\n"						\
+	      "1: .byte 0xe9\n"						\
+	      ".long %l[__litl_site_check] - 2f\n"			\
+	      "2:\n"							\
+	      ".pushsection litl_site_jumps, \"aw\"\n"			\
+	      ".balign 8\n"						\
+	      ".quad 1b, %l[__litl_site_enabled], %c0\n"		\
+	      ".popsection\n"						\
+	      : : "i" (&__litl_site) : :				\
+	      __litl_site_check, __litl_site_enabled);			\
+    if (0) {								\
+    __litl_site_check: __attribute__ ((cold));				\
+      if (__atomic_load_n(&__litl_site.is_enabled, __ATOMIC_RELAXED)) {	\
+      __litl_site_enabled: __attribute__ ((cold));			\
+	statement;							\
+      }									\
+    }									\
+  } while (0)
+#else
+#define LITL_SITE(group, statement) do {				\
+    static litl_site_t __litl_site					\
+      __attribute__ ((section("litl_sites"), used, aligned(8))) =	\
+      { group, __FILE__, __LINE__, 0 };					\
+    if (__builtin_expect(__atomic_load_n(&__litl_site.is_enabled,	\
+					 __ATOMIC_RELAXED), 0)) {	\
+      statement;							\
+    }									\
+  } while (0)
+#endif
+
+/**
+ * \ingroup litl_site
+ * \brief Enables a probe site
+ * \param site A pointer to the site
+ * \return Returns -1 if the site could not be patched. Otherwise, returns 0
+ */
+int litl_site_enable(litl_site_t* site);
+
+/**
+ * \ingroup litl_site
+ * \brief Disables a probe site
+ * \param site A pointer to the site
+ * \return Returns -1 if the site could not be patched. Otherwise, returns 0
+ */
+int litl_site_disable(litl_site_t* site);
+
+/**
+ * \ingroup litl_site
+ * \brief Enables all the probe sites of a group
+ * \param group A name of the group, or NULL for all the sites
+ * \return The number of sites in the group, or -1 if a site could not be
+ *  patched
+ */
+int litl_site_enable_group(const char* group);
+
+/**
+ * \ingroup litl_site
+ * \brief Disables all the probe sites of a group
+ * \param group A name of the group, or NULL for all the sites
+ * \return The number of sites in the group, or -1 if a site could not be
+ *  patched
+ */
+int litl_site_disable_group(const char* group);
+
+/**
+ * \ingroup litl_site
+ * \brief For internal use only. Registers the probe sites of a module (the
+ *  executable or a shared library). The groups listed in LITL_SITES are
+ *  enabled
+ * \param sites A pointer to the beginning of the litl_sites section
+ * \param sites_end A pointer to the end of the litl_sites section
+ * \param jumps A pointer to the beginning of the litl_site_jumps section
+ * \param jumps_end A pointer to the end of the litl_site_jumps section
+ */
+void __litl_site_register(litl_site_t* sites, litl_site_t* sites_end,
+			  litl_site_jump_t* jumps, litl_site_jump_t* jumps_end);
+
+/**
+ * \ingroup litl_site
+ * \brief For internal use only. Unregisters the probe sites of a module, e.g.
+ *  a shared library that is unloaded with dlclose()
+ * \param sites A pointer to the beginning of the litl_sites section
+ */
+void __litl_site_unregister(litl_site_t* sites);
+
+/*
+ * For internal use only.
+ * The linker defines these symbols in the modules that contain probe sites
+ */
+extern litl_site_t __start_litl_sites[]
+  __attribute__ ((weak, visibility("hidden")));
+extern litl_site_t __stop_litl_sites[]
+  __attribute__ ((weak, visibility("hidden")));
+extern litl_site_jump_t __start_litl_site_jumps[]
+  __attribute__ ((weak, visibility("hidden")));
+extern litl_site_jump_t __stop_litl_site_jumps[]
+  __attribute__ ((weak, visibility("hidden")));
+
+/*
+ * For internal use only.
+ * Registers the probe sites of the module when it is loaded
+ */
+static void __attribute__ ((constructor, used)) __litl_site_register_module() {
+  if (__start_litl_sites)
+    __litl_site_register(__start_litl_sites, __stop_litl_sites,
+			 __start_litl_site_jumps, __stop_litl_site_jumps);
+}
+
+/*
+ * For internal use only.
+ * Unregisters the probe sites of the module when it is unloaded
+ */
+static void __attribute__ ((destructor, used)) __litl_site_unregister_module() {
+  if (__start_litl_sites)
+    __litl_site_unregister(__start_litl_sites);
+}
+
+#endif /* LITL_SITE_H_ */
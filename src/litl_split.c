@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#include "litl_tools.h"
 #include "litl_split.h"
 
 static litl_trace_split_t* __arch;
@@ -56,6 +57,12 @@ static void __litl_split_read_header() {
     exit(EXIT_SUCCESS);
   }
 
+  if (!__litl_has_process_flags(__arch->trace_header)) {
+    fprintf(stderr,
+            "[litl_split] The archive was created by an older version of LiTL and cannot be split\n");
+    exit(EXIT_FAILURE);
+  }
+
   // Yes, we work with an archive of trace. So, we increase the header size
   //   and relocate the header buffer
   header_size += __arch->nb_processes * sizeof(litl_process_header_t);
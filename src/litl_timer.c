@@ -21,20 +21,10 @@ static void __litl_time_ticks_initialize();
     abort();								\
   } while(0)
 
-// Choose the default timing method
-#if CLOCK_GETTIME_AVAIL
-#ifdef CLOCK_MONOTONIC_RAW
-#define TIMER_DEFAULT litl_get_time_monotonic_raw
-#else
-#define TIMER_DEFAULT litl_get_time_monotonic
-#endif	// CLOCK_MONOTONIC_RAW
-#else  // CLOCK_GETTIME_AVAIL
-#define TIMER_DEFAULT litl_get_time_ticks
-#endif // CLOCK_GETTIME_AVAIL
 /*
  * Selected timing method
  */
-litl_timing_method_t litl_get_time = TIMER_DEFAULT;
+litl_timing_method_t litl_get_time = LITL_TIMER_DEFAULT;
 
 /*
  * Benchmarks function f and returns the number of calls to f that can be done
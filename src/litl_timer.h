@@ -17,6 +17,7 @@
  *        Francois Trahay   -- francois.trahay@telecom-sudparis.eu \n
  */
 
+#include <time.h>
 #include "litl_types.h"
 
 /**
@@ -113,4 +114,38 @@ litl_time_t litl_get_time_ticks();
  */
 litl_time_t litl_get_time_none();
 
+/*
+ * For internal use only.
+ * The default timing method and, if it uses clock_gettime, its clock
+ */
+#if CLOCK_GETTIME_AVAIL
+#ifdef CLOCK_MONOTONIC_RAW
+#define LITL_TIMER_DEFAULT litl_get_time_monotonic_raw
+#define LITL_TIMER_DEFAULT_CLOCK CLOCK_MONOTONIC_RAW
+#else
+#define LITL_TIMER_DEFAULT litl_get_time_monotonic
+#define LITL_TIMER_DEFAULT_CLOCK CLOCK_MONOTONIC
+#endif	// CLOCK_MONOTONIC_RAW
+#else  // CLOCK_GETTIME_AVAIL
+#define LITL_TIMER_DEFAULT litl_get_time_ticks
+#endif // CLOCK_GETTIME_AVAIL
+
+/**
+ * \ingroup litl_timer_measure
+ * \brief Gets the current time in ns like litl_get_time. The default timing
+ *  method is measured inline, the other ones are called through
+ *  litl_get_time
+ * \return Returns the time measured by the selected timing method
+ */
+static inline litl_time_t litl_get_time_inline() {
+#ifdef LITL_TIMER_DEFAULT_CLOCK
+  if (__builtin_expect(litl_get_time == LITL_TIMER_DEFAULT, 1)) {
+    struct timespec tp;
+    clock_gettime(LITL_TIMER_DEFAULT_CLOCK, &tp);
+    return 1000000000 * tp.tv_sec + tp.tv_nsec;
+  }
+#endif
+  return litl_get_time();
+}
+
 #endif /* LITL_TIMER_H_ */
@@ -5,6 +5,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <math.h>
 
@@ -26,9 +27,18 @@ litl_size_t __litl_get_event_size(litl_type_t type, int param_size) {
   case LITL_TYPE_RAW:
     return LITL_BASE_SIZE + param_size + sizeof(((litl_t*)0)->parameters.raw.size);
   case LITL_TYPE_PACKED:
+  case LITL_TYPE_FRAGMENT:
     return LITL_BASE_SIZE + param_size + sizeof(((litl_t*)0)->parameters.packed.size);
   case LITL_TYPE_OFFSET:
     return LITL_BASE_SIZE + param_size + sizeof(((litl_t*)0)->parameters.offset.nb_params);
+  case LITL_TYPE_TIME:
+    return LITL_BASE_SIZE + sizeof(((litl_t*)0)->parameters.time.time);
+  case LITL_TYPE_VARINT:
+    return LITL_BASE_SIZE + param_size
+      + sizeof(((litl_t*)0)->parameters.varint.nb_params)
+      + sizeof(((litl_t*)0)->parameters.varint.size);
+  case LITL_TYPE_STRING:
+    return LITL_BASE_SIZE + sizeof(((litl_t*)0)->parameters.string.id);
   default:
     fprintf(stderr, "Unknown event type %d!\n", type);
     abort();
@@ -46,9 +56,16 @@ litl_size_t __litl_get_gen_event_size(litl_t *p_evt) {
   case LITL_TYPE_RAW:
     return __litl_get_event_size(p_evt->type, p_evt->parameters.raw.size);
   case LITL_TYPE_PACKED:
+  case LITL_TYPE_FRAGMENT:
     return __litl_get_event_size(p_evt->type, p_evt->parameters.packed.size);
   case LITL_TYPE_OFFSET:
     return __litl_get_event_size(p_evt->type, p_evt->parameters.offset.nb_params);
+  case LITL_TYPE_TIME:
+    return __litl_get_event_size(p_evt->type, 0);
+  case LITL_TYPE_VARINT:
+    return __litl_get_event_size(p_evt->type, p_evt->parameters.varint.size);
+  case LITL_TYPE_STRING:
+    return __litl_get_event_size(p_evt->type, 0);
   default:
     fprintf(stderr, "Unknown event type %d!\n", p_evt->type);
     abort();
@@ -56,3 +73,58 @@ litl_size_t __litl_get_gen_event_size(litl_t *p_evt) {
 
   return 0;
 }
+
+/*
+ * Returns the size in bytes of a parameter encoded in LEB128
+ */
+litl_size_t __litl_get_varint_size(litl_param_t value) {
+  litl_size_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/*
+ * Encodes a parameter in LEB128 and returns the position that follows it
+ */
+litl_buffer_t __litl_encode_varint(litl_buffer_t buffer, litl_param_t value) {
+  while (value >= 0x80) {
+    *buffer++ = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  *buffer++ = value;
+  return buffer;
+}
+
+/*
+ * Decodes a parameter encoded in LEB128 and returns the position that
+ *   follows it
+ */
+litl_buffer_t __litl_decode_varint(litl_buffer_t buffer, litl_param_t* value) {
+  unsigned shift = 0;
+  *value = 0;
+  do {
+    *value |= (litl_param_t) (*buffer & 0x7f) << shift;
+    shift += 7;
+  } while (*buffer++ & 0x80);
+  return buffer;
+}
+
+/*
+ * Checks whether the process headers store the format flags, i.e. whether the
+ *   trace was recorded by LiTL 0.3 or later
+ */
+int __litl_has_process_flags(litl_general_header_t* header) {
+  char version[sizeof(header->litl_ver) + 1];
+  unsigned major, minor;
+
+  memcpy(version, header->litl_ver, sizeof(header->litl_ver));
+  version[sizeof(header->litl_ver)] = '\0';
+  if (sscanf(version, "%u.%u", &major, &minor) != 2)
+    return 0;
+
+  return major > LITL_FLAGS_MAJOR_VERSION
+    || (major == LITL_FLAGS_MAJOR_VERSION && minor >= LITL_FLAGS_MINOR_VERSION);
+}
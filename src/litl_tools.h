@@ -53,4 +53,39 @@ litl_size_t __litl_get_event_size(litl_type_t type, int param_size);
  */
 litl_size_t __litl_get_gen_event_size(litl_t *p_evt);
 
+/**
+ * \ingroup litl_tools
+ * \brief Returns the size of a parameter encoded in LEB128 (in Bytes)
+ * \param value A parameter
+ * \return A size of the encoded parameter
+ */
+litl_size_t __litl_get_varint_size(litl_param_t value);
+
+/**
+ * \ingroup litl_tools
+ * \brief Encodes a parameter in LEB128
+ * \param buffer A pointer to the encoded parameter
+ * \param value A parameter
+ * \return A pointer to the Byte that follows the encoded parameter
+ */
+litl_buffer_t __litl_encode_varint(litl_buffer_t buffer, litl_param_t value);
+
+/**
+ * \ingroup litl_tools
+ * \brief Decodes a parameter encoded in LEB128
+ * \param buffer A pointer to the encoded parameter
+ * \param value A pointer to the decoded parameter
+ * \return A pointer to the Byte that follows the encoded parameter
+ */
+litl_buffer_t __litl_decode_varint(litl_buffer_t buffer, litl_param_t* value);
+
+/**
+ * \ingroup litl_tools
+ * \brief Checks whether the process headers of a trace store the format flags,
+ *  depending on the version of LiTL that recorded it
+ * \param header A pointer to the general header of the trace
+ * \return 1 if the process headers store the flags, 0 otherwise
+ */
+int __litl_has_process_flags(litl_general_header_t* header);
+
 #endif /* LITL_TOOLS_H_ */
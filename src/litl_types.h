@@ -155,6 +155,19 @@ typedef uint16_t litl_med_size_t;
  * \brief A data type for the optimized storage of parameters
  */
 typedef uint8_t litl_data_t;
+/**
+ * \ingroup litl_types_general
+ * \brief A data type for storing the time elapsed since the previous event of
+ *  a thread (delta-encoded timestamps)
+ */
+typedef uint32_t litl_time_delta_t;
+
+/**
+ * \ingroup litl_types_general
+ * \brief A data type for storing the id of a string of the string table. The
+ *  ids start from 1
+ */
+typedef uint32_t litl_string_id_t;
 
 /**
  * \ingroup litl_types_general
@@ -162,6 +175,33 @@ typedef uint8_t litl_data_t;
  */
 #define LITL_OFFSET_CODE 13
 
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the code of the regular events that store the sampling
+ *  counters of a thread for a sampled code: (code, policy, value of the
+ *  policy, number of events, number of recorded events). They are recorded
+ *  at the end of the chunks in which the counters changed. This code and
+ *  LITL_OFFSET_CODE are reserved
+ */
+#define LITL_SAMPLING_CODE 14
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the code of the packed events that add a string to the
+ *  string table: its id (litl_string_id_t) followed by its characters. They
+ *  are recorded by the thread that adds the string, before the events that
+ *  carry its id. This code is reserved as well
+ */
+#define LITL_STRING_CODE 15
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of slots of the string table of a trace. At most
+ *  half of them hold strings, the data of the other raw events are recorded
+ *  as usual
+ */
+#define LITL_STRING_TABLE_SIZE 8192
+
 /**
  * \ingroup litl_types_general
  * \brief Defines the maximum number of parameters
@@ -172,6 +212,11 @@ typedef uint8_t litl_data_t;
  * \brief Defines the "maximum" size of raw data
  */
 #define LITL_MAX_DATA (LITL_MAX_PARAMS * sizeof(litl_param_t))
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the maximum size of a variable-length parameter (in Bytes)
+ */
+#define LITL_VARINT_MAX_SIZE ((sizeof(litl_param_t) * 8 + 6) / 7)
 
 /**
  * \ingroup litl_types_general
@@ -181,7 +226,11 @@ typedef enum {
   LITL_TYPE_REGULAR /**< Regular */,
   LITL_TYPE_RAW /**< Raw */,
   LITL_TYPE_PACKED /**< Packed */,
-  LITL_TYPE_OFFSET /**< Offset */
+  LITL_TYPE_OFFSET /**< Offset */,
+  LITL_TYPE_TIME /**< Time synchronization (delta-encoded timestamps only) */,
+  LITL_TYPE_VARINT /**< Regular with variable-length parameters */,
+  LITL_TYPE_FRAGMENT /**< A fragment of a packed event that does not fit in a buffer. The fragments are followed by a packed event that holds the end of the data */,
+  LITL_TYPE_STRING /**< Raw whose data is replaced by the id of a string of the string table (LITL_FLAG_STRING_TABLE only). The reader turns it back into a raw event */
 }__attribute__((packed)) litl_type_t;
 
 /**
@@ -230,6 +279,29 @@ typedef struct {
       litl_data_t nb_params; /**< A number of parameters (=1) */
       litl_param_t offset; /**< An offset to the next chunk of events */
     }__attribute__((packed)) offset;
+    /**
+     * \struct time
+     * \brief A time synchronization event
+     */
+    struct {
+      litl_time_t time; /**< The time of the following event */
+    }__attribute__((packed)) time;
+    /**
+     * \struct varint
+     * \brief A regular event with variable-length parameters
+     */
+    struct {
+      litl_data_t nb_params; /**< A number of arguments */
+      litl_data_t size; /**< A size of the encoded arguments (in Bytes) */
+      litl_data_t param[LITL_MAX_PARAMS * LITL_VARINT_MAX_SIZE]; /**< Arguments encoded in LEB128: 7 bits per Byte, the highest bit indicates that another Byte follows */
+    }__attribute__((packed)) varint;
+    /**
+     * \struct string
+     * \brief A raw event whose data is in the string table
+     */
+    struct {
+      litl_string_id_t id; /**< An id of the string */
+    }__attribute__((packed)) string;
   } parameters;
 }__attribute__((packed)) litl_t;
 
@@ -241,6 +313,80 @@ typedef struct {
  */
 #define NBTHREADS 32
 
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of thread-specific buffers in the first segment of
+ *  the buffer table. Each next segment is twice as large as the previous one
+ */
+#define LITL_BUFFER_SEGMENT_SIZE 256
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the maximum number of segments in the buffer table. The
+ *  segments 0 to 8 hold the 2^16 thread indices of litl_med_size_t
+ */
+#define LITL_NB_BUFFER_SEGMENTS 9
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the maximum number of NUMA nodes that trace buffers are bound
+ *  to. The buffers of threads running on the other nodes are not bound
+ */
+#define LITL_MAX_NUMA_NODES 64
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the size of a cache line, which separates the chunks and the
+ *  buffers of different threads
+ */
+#define LITL_CACHE_LINE_SIZE 64
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of chunks that are added at once to the shared
+ *  pool of chunks
+ */
+#define LITL_CHUNKS_PER_SLAB 32
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of chunks of the trace file that a thread maps at
+ *  once when the trace file is mapped
+ */
+#define LITL_CHUNKS_PER_WINDOW 4
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of writes that the io_uring of a thread holds,
+ *  which is at least the number of writes of a chunk
+ */
+#define LITL_URING_ENTRIES 4
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the number of event codes that can be filtered individually.
+ *  The codes above share the same filtering state
+ */
+#define LITL_FILTER_NB_CODES 0x10000
+
+/**
+ * \ingroup litl_types_general
+ * \brief The state bits of an event code: its events are recorded
+ */
+#define LITL_CODE_ENABLED 0x1
+
+/**
+ * \ingroup litl_types_general
+ * \brief The state bits of an event code: its events are sampled
+ */
+#define LITL_CODE_SAMPLED 0x2
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the maximum number of sampled event codes
+ */
+#define LITL_MAX_SAMPLING_RULES 16
+
 /**
  * \ingroup litl_types_general
  * \brief A general data structure that corresponds to the header of a trace
@@ -252,6 +398,60 @@ typedef struct {
   litl_med_size_t nb_processes; /**< A number of processes in the trace file */
 }__attribute__((packed)) __attribute__((aligned(8))) litl_general_header_t;
 
+/**
+ * \ingroup litl_types_general
+ * \brief Indicates that the events of each thread are stored in a separate
+ *  file named <trace file>.<thread index>
+ */
+#define LITL_FLAG_PER_THREAD_FILES 0x1
+
+/**
+ * \ingroup litl_types_general
+ * \brief Flag of the process header: events store the time elapsed since the
+ *  previous event of the thread instead of the time of the measurement
+ */
+#define LITL_FLAG_DELTA_TIME 0x2
+
+/**
+ * \ingroup litl_types_general
+ * \brief Flag of the process header: regular events store their parameters
+ *  with a variable length (LITL_TYPE_VARINT)
+ */
+#define LITL_FLAG_VARINT_PARAMS 0x4
+
+/**
+ * \ingroup litl_types_general
+ * \brief Flag of the process header: each chunk of events is stored in a
+ *  block that may be compressed (litl_block_header_t)
+ */
+#define LITL_FLAG_COMPRESSED 0x8
+
+/**
+ * \ingroup litl_types_general
+ * \brief Flag of the process header: the chunks of events are not linked by
+ *  their offset events. The threads and the offsets of their chunks are
+ *  listed in a footer index (litl_footer_thread_t), which the only pair
+ *  (tid, offset) of the header points to
+ */
+#define LITL_FLAG_FOOTER_INDEX 0x10
+
+/**
+ * \ingroup litl_types_general
+ * \brief Flag of the process header: the data of raw events are stored once
+ *  in a string table (LITL_STRING_CODE events), and the raw events carry
+ *  their id (LITL_TYPE_STRING)
+ */
+#define LITL_FLAG_STRING_TABLE 0x20
+
+/**
+ * \ingroup litl_types_general
+ * \brief Defines the first version of LiTL (major.minor) whose process headers
+ *  store the format flags. In the traces recorded by older versions, the
+ *  process headers end before the flags
+ */
+#define LITL_FLAGS_MAJOR_VERSION 0
+#define LITL_FLAGS_MINOR_VERSION 3
+
 /**
  * \ingroup litl_types_general
  * \brief A general data structure that corresponds to the header of a trace
@@ -264,8 +464,22 @@ typedef struct {
   litl_size_t buffer_size; /**< A size of buffer */
   litl_trace_size_t trace_size; /**< A trace size */
   litl_offset_t offset; /**< An offset to the process-specific threads pairs and their events */
+  litl_size_t flags; /**< Format options of the process (LITL_FLAG_*) */
 } __attribute__((packed))  __attribute__((aligned(8))) litl_process_header_t;
 
+/**
+ * \ingroup litl_types_general
+ * \brief A header of a block of events (LITL_FLAG_COMPRESSED only). The
+ *  offset to the next chunk of the thread is stored here instead of in the
+ *  offset event at the end of the compressed events
+ */
+typedef struct {
+  litl_offset_t offset; /**< An offset to the next chunk of events */
+  litl_size_t size; /**< A size of the events (in Bytes) */
+  litl_size_t compressed_size; /**< A size of the compressed events that follow the header (in Bytes) */
+  litl_data_t codec; /**< An identifier of the codec, LITL_CODEC_NONE if the events are not compressed */
+} __attribute__((packed)) litl_block_header_t;
+
 /**
  * \ingroup litl_types_general
  * \brief A data structure for pairs (tid, offset) stored in the trace header
@@ -275,6 +489,16 @@ typedef struct {
   litl_offset_t offset; /**< An offset to the chunk of events */
 } __attribute__((aligned(8))) litl_thread_pair_t;
 
+/**
+ * \ingroup litl_types_general
+ * \brief A thread of the footer index (LITL_FLAG_FOOTER_INDEX only). It is
+ *  followed by the offsets of the chunks of the thread, in order
+ */
+typedef struct {
+  litl_tid_t tid; /**< A thread ID */
+  litl_size_t nb_chunks; /**< A number of chunks of events of the thread */
+} __attribute__((packed)) litl_footer_thread_t;
+
 /**
  * \ingroup litl_types_general
  * \brief A data structure for triples (nb_processes, position, offset)
@@ -287,24 +511,202 @@ typedef struct {
 
 /**
  * \ingroup litl_types_write
- * \brief Thread-specific buffer
+ * \brief The sampling policies of event codes
+ */
+typedef enum {
+  LITL_SAMPLING_NONE /**< Record all the events */,
+  LITL_SAMPLING_ONE_IN_N /**< Record one event out of value */,
+  LITL_SAMPLING_MAX_RATE /**< Record at most value events per millisecond */,
+  LITL_SAMPLING_BUDGET /**< Adapt the sampling period so that the events take at most value Bytes per second */
+} litl_sampling_policy_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief The sampling policy of an event code. The policy applies to each
+ *  thread separately
+ */
+typedef struct {
+  litl_code_t code; /**< An event code */
+  litl_sampling_policy_t policy; /**< A sampling policy */
+  litl_size_t value; /**< A parameter of the policy */
+} litl_sampling_rule_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief The sampling state of a thread for a sampled code
+ */
+typedef struct {
+  litl_trace_size_t nb_events; /**< A number of events of the code */
+  litl_trace_size_t nb_recorded_events; /**< A number of recorded events of the code */
+  litl_size_t period; /**< A current sampling period (1 event out of period) */
+  litl_size_t countdown; /**< A number of events to skip before the next recorded one */
+  litl_time_t window_start; /**< The beginning of the current time window */
+  uint64_t window_usage; /**< The credit of events (max rate) or the recorded Bytes (budget) in the window */
+  litl_trace_size_t nb_reported_events; /**< A number of events of the code when the counters were last recorded */
+} litl_sampling_state_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief Thread-specific buffer. Each one starts on its own cache line, so the
+ *  threads that record events do not falsely share the fields updated by
+ *  each event, which come first
  */
 typedef struct {
   litl_buffer_t buffer_ptr; /**< A pointer to the beginning of the buffer */
   litl_buffer_t buffer; /**< A pointer to the next free slot */
+  litl_size_t capacity; /**< A number of Bytes of events that the buffer holds */
+  litl_time_t last_time; /**< The time of the last event in the buffer (delta-encoded timestamps only) */
 
   litl_tid_t tid; /**< An ID of the working thread */
   litl_offset_t offset; /**< An offset to the next buffer in the trace file */
 
   litl_data_t already_flushed; /**< Handles the situation when some threads start after the header was flushed, i.e. their tids and offsets were not included into the header*/
   int initialized;
-} litl_write_buffer_t;
+
+  litl_buffer_t* spare_buffers; /**< Buffers that replace the current one while it is written by the background flusher */
+  litl_med_size_t nb_spare_buffers; /**< A number of spare buffers that are ready to be used */
+
+  int f_handle; /**< A file handler of the thread-specific trace file (per-thread files only) */
+  litl_offset_t general_offset; /**< An offset from the beginning of the thread-specific trace file to the next free slot */
+
+  litl_buffer_t* ring_buffers; /**< Full buffers kept in the flight-recorder mode, from the oldest one (at ring_head) to the newest one */
+  litl_size_t* ring_sizes; /**< Sizes of data in the full buffers of the flight recorder */
+  litl_buffer_t block_ptr; /**< A buffer that stores the compressed block of events before it is written (compression only) */
+
+  litl_med_size_t ring_capacity; /**< A maximum number of full buffers kept by the flight recorder */
+  litl_med_size_t ring_head; /**< A position of the oldest full buffer of the flight recorder */
+  litl_med_size_t nb_ring_buffers; /**< A number of full buffers kept by the flight recorder */
+  litl_size_t ring_seq; /**< A sequence number that is odd while the flight recorder replaces its buffers */
+
+  litl_sampling_state_t* sampling; /**< The sampling states of the thread, indexed like the sampling rules (sampling only) */
+  int numa_node; /**< The NUMA node that the buffers of the thread are bound to, or -1 (NUMA placement only) */
+
+  litl_buffer_t* full_chunks; /**< Full chunks kept until the trace is finalized, from the oldest one (chunk pool without buffer flush only) */
+  litl_size_t* full_chunk_sizes; /**< Sizes of data in the full chunks */
+  litl_size_t nb_full_chunks; /**< A number of full chunks */
+  litl_size_t full_chunks_size; /**< A number of Bytes of events in the full chunks */
+
+  litl_med_size_t nb_pending_buffers; /**< A number of buffers of the thread in the flush queue or being written by the background flusher */
+
+  litl_size_t footer_thread; /**< An index plus one of the thread in the footer index, or 0 if none of its chunks was written (footer index only) */
+
+  litl_buffer_t mapped_window; /**< A mapping of the region of the trace file that holds the current chunk, or NULL (mapped output only) */
+  litl_offset_t mapped_offset; /**< An offset of the current chunk in the trace file (mapped output only) */
+  litl_med_size_t mapped_chunk; /**< A position of the current chunk in its mapping (mapped output only) */
+
+  struct litl_write_uring* uring; /**< The io_uring that writes the chunks of the thread, or NULL (io_uring only) */
+
+  litl_t* reserved_event; /**< The event reserved in the buffer and not committed yet, or NULL (reserve/commit only) */
+  litl_buffer_t reserved_data; /**< The payload reserved outside of the buffer because it does not fit in one, or NULL (reserve/commit only) */
+  litl_size_t reserved_size; /**< A size of the payload reserved outside of the buffer */
+  litl_code_t reserved_code; /**< An event code of the payload reserved outside of the buffer */
+  litl_sampling_state_t* reserved_sampling; /**< The sampling state of the code of the payload reserved outside of the buffer, or NULL */
+  litl_buffer_t staging; /**< A memory region that holds the payloads reserved outside of the buffer until they are committed as fragments */
+  litl_size_t staging_size; /**< A size of the staging region */
+} __attribute__((aligned(LITL_CACHE_LINE_SIZE))) litl_write_buffer_t;
 
 /**
  * \ingroup litl_types_write
- * \brief A data structure for recording events
+ * \brief A thread of the footer index kept in memory until it is written
+ */
+typedef struct {
+  litl_tid_t tid; /**< A thread ID */
+  litl_offset_t* chunks; /**< The offsets of the written chunks of the thread */
+  litl_size_t nb_chunks; /**< A number of written chunks */
+  litl_size_t max_chunks; /**< A number of offsets that chunks can hold */
+} litl_footer_entry_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief A slot of the string table of a trace
  */
 typedef struct {
+  uint32_t hash; /**< A hash of the string, or 0 if the slot is free */
+  litl_string_id_t id; /**< An id of the string, or 0 while the string is added */
+  litl_size_t size; /**< A size of the string (in Bytes) */
+  litl_data_t is_recorded; /**< Indicates whether the event that adds the string to the trace was recorded */
+  litl_buffer_t string; /**< The id of the string followed by its characters */
+} litl_string_slot_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief The value of the private thread variable of a trace. When the thread
+ *  exits, it tells which buffer to flush and recycle
+ */
+typedef struct {
+  struct litl_write_trace* trace; /**< A pointer to the trace */
+  litl_med_size_t index; /**< An index of the thread in the trace */
+} litl_write_thread_key_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief A thread-local cache of the thread-specific buffer of a trace
+ */
+typedef struct {
+  struct litl_write_trace* trace; /**< A pointer to the cached trace */
+  litl_size_t generation; /**< A generation of the cached trace */
+  litl_med_size_t index; /**< An index of the calling thread in the trace */
+  litl_write_buffer_t* buffer; /**< A pointer to the buffer of the calling thread */
+} litl_write_thread_cache_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief The behavior of recording threads when the background flusher falls
+ *  behind, i.e. when a thread has no spare buffer or the flush queue is full
+ */
+typedef enum {
+  LITL_FLUSH_POLICY_BLOCK /**< Wait until the background flusher releases a buffer */,
+  LITL_FLUSH_POLICY_DROP /**< Drop the event and keep the full buffer */
+} litl_flush_policy_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief The kind of pages that back the buffers. Each kind falls back to the
+ *  previous one when it is not available
+ */
+typedef enum {
+  LITL_HUGEPAGES_NONE /**< Regular pages */,
+  LITL_HUGEPAGES_THP /**< Transparent huge pages, requested with madvise */,
+  LITL_HUGEPAGES_HUGETLB /**< Huge pages reserved by the administrator (MAP_HUGETLB) */
+} litl_hugepages_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief A full buffer waiting to be written by the background flusher
+ */
+typedef struct {
+  litl_med_size_t index; /**< An index of the thread that owns the buffer */
+  litl_buffer_t buffer_ptr; /**< A pointer to the beginning of the buffer */
+  litl_size_t size; /**< A size of data in the buffer */
+  int numa_node; /**< The NUMA node that the buffer is bound to, or -1 */
+} litl_flush_request_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief A write to the trace file. The writes of a chunk are submitted
+ *  together
+ */
+typedef struct {
+  const void* data; /**< A pointer to the data to write */
+  size_t size; /**< A size of the data */
+  litl_offset_t position; /**< A position of the data in the trace file */
+} litl_write_io_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief Buffers bound to a NUMA node and ready to be used by the threads that
+ *  start or migrate there
+ */
+typedef struct {
+  litl_buffer_t* buffers; /**< The buffers of the pool */
+  litl_med_size_t nb_buffers; /**< A number of buffers in the pool */
+} litl_numa_pool_t;
+
+/**
+ * \ingroup litl_types_write
+ * \brief A data structure for recording events
+ */
+typedef struct litl_write_trace {
   int f_handle; /**< A file handler */
   char* filename; /**< A file name */
 
@@ -317,27 +719,107 @@ typedef struct {
   litl_med_size_t header_nb_threads; /**< A number of threads in the header */
   litl_data_t is_header_flushed; /**< Indicates whether the header with threads pairs has been flushed */
 
-  litl_med_size_t nb_threads; /**< A number of threads */
+  litl_med_size_t nb_threads; /**< A number of registered threads */
+  litl_med_size_t* free_slots; /**< The indexes of the buffers released by the threads that exited, which are reused by the new threads */
+  litl_med_size_t nb_free_slots; /**< A number of released buffers */
+  pthread_mutex_t lock_free_slots; /**< Protects the released buffers */
+  litl_med_size_t nb_flushed_threads; /**< A number of threads, which pair (tid, offset) is stored in the trace file */
   litl_med_size_t nb_slots; /**< A number of chunks with the information on threads (tid, offset); first chunk, which is in the header, does not count; each contains at most NBTHREADS threads */
   litl_param_t threads_offset; /**< An offset to the next chunk of pairs (tid, offset) for a given thread */
 
-  litl_write_buffer_t **buffers; /**< An array of thread-specific buffers */
-  litl_size_t nb_allocated_buffers; /**< A number of thread-specific buffers that are allocated */
+  litl_write_buffer_t *buffer_segments[LITL_NB_BUFFER_SEGMENTS]; /**< A table of thread-specific buffers. Segments are allocated on demand and never move, so they can be read without any lock */
   litl_size_t buffer_size; /**< A buffer size */
   litl_data_t is_buffer_full; /**< Indicates whether the buffer is full */
 
   pthread_once_t index_once; /**< Guarantees that the initialization function is called only once */
-  pthread_key_t index; /**< A private thread variable that holds its index */
+  pthread_key_t index; /**< A private thread variable that holds its index. Its destructor flushes and recycles the buffer of the threads that exit */
+  litl_size_t generation; /**< A unique identifier of the trace object that validates the thread-local cache of the thread buffer */
   pthread_mutex_t lock_litl_flush; /**< Handles write conflicts while using pthread */
-  pthread_mutex_t lock_buffer_init; /**< Handles race conditions while initializing threads pairs and buffers pointers */
 
   litl_data_t is_litl_initialized; /**< Ensures that a performance analysis library does not start recording events before the initialization is finished */
   volatile litl_data_t is_recording_paused; /**< Indicates whether LiTL stops recording events (1) for a while or not (0) */
   litl_data_t allow_buffer_flush; /**< Indicates whether buffer flush is enabled (1) or not (0). In case the flushing is disabled, the recording of events is stopped. By default, it is activated */
   litl_data_t allow_thread_safety; /**< Indicates whether LiTL uses thread-safety (1) or not (0). By default, it is activated */
   litl_data_t allow_tid_recording; /**< Indicates whether LiTL records tid (1) or not (0). By default, it is activated */
+  litl_data_t allow_ring_buffer; /**< Indicates whether each thread keeps its last events in memory and overwrites the oldest ones (1) or not (0). By default, it is deactivated */
+  litl_data_t allow_per_thread_files; /**< Indicates whether each thread writes its events to its own file (1) or not (0). By default, it is deactivated */
+  litl_data_t allow_delta_time; /**< Indicates whether events store the time elapsed since the previous event (1) or the full time (0). By default, it is deactivated */
+  litl_data_t allow_varint_params; /**< Indicates whether regular events store their parameters with a variable length (1) or not (0). By default, it is deactivated */
+  const struct litl_codec* codec; /**< The codec that compresses the chunks of events before they are written, or NULL. By default, chunks are not compressed */
+
+  litl_data_t code_filter[LITL_FILTER_NB_CODES / 4 + 1]; /**< The states of the event codes on 2 bits (LITL_CODE_ENABLED, LITL_CODE_SAMPLED). The last state stands for all the codes from LITL_FILTER_NB_CODES. By default, all the codes are enabled */
+  litl_sampling_rule_t sampling_rules[LITL_MAX_SAMPLING_RULES]; /**< The sampling policies of the sampled codes */
+  litl_med_size_t nb_sampling_rules; /**< A number of sampling rules */
+  uint32_t keymask; /**< A mask of the enabled FxT event classes. By default, all the classes are enabled */
+
+  litl_data_t allow_async_flush; /**< Indicates whether full buffers are written by a background thread (1) or by the recording thread (0). By default, it is deactivated */
+  litl_flush_policy_t flush_policy; /**< What recording threads do when the background flusher falls behind */
+  litl_med_size_t nb_buffers; /**< A number of buffers per thread when the background flusher is used */
+  litl_med_size_t flush_queue_depth; /**< A maximum number of full buffers waiting to be written */
+  litl_flush_request_t* flush_queue; /**< A circular queue of full buffers waiting to be written */
+  litl_med_size_t flush_queue_head; /**< An index of the oldest request in the flush queue */
+  litl_med_size_t flush_queue_count; /**< A number of requests in the flush queue */
+  pthread_t flush_thread; /**< The background flusher */
+  litl_data_t is_flush_thread_running; /**< Indicates whether the background flusher was started */
+  litl_data_t is_flush_thread_stopping; /**< Asks the background flusher to exit once the queue is empty */
+  pthread_mutex_t lock_flush_queue; /**< Protects the flush queue and the spare buffers */
+  pthread_cond_t flush_queue_cond; /**< Signaled when a request is added to the flush queue */
+  pthread_cond_t flush_done_cond; /**< Signaled when the background flusher releases a buffer */
+  litl_trace_size_t nb_dropped_events; /**< A number of events dropped because the background flusher fell behind */
+
+  litl_size_t chunk_size; /**< A size of the chunks of the shared pool, or 0 if each thread has its own buffer. By default, it is 0 */
+  litl_buffer_t chunk_pool; /**< The free chunks, linked through their first Bytes */
+  litl_buffer_t* chunk_slabs; /**< The memory areas that hold the chunks */
+  litl_size_t nb_chunk_slabs; /**< A number of memory areas that hold the chunks */
+  pthread_mutex_t lock_chunk_pool; /**< Protects the chunk pool */
+
+  litl_hugepages_t hugepages; /**< The kind of pages requested for the buffers. By default, regular pages */
+  litl_hugepages_t hugepages_obtained; /**< The kind of pages actually obtained: the requested one, or the fallback used by at least one buffer */
+  size_t hugepage_size; /**< The size of huge pages, which the buffer mappings are rounded up to */
+
+  litl_data_t allow_direct_io; /**< Indicates whether the chunks are written with O_DIRECT (1) or through the page cache (0). By default, it is deactivated */
+  int f_direct_handle; /**< A file handler of the trace file opened with O_DIRECT, or -1 */
+  litl_data_t is_direct_io; /**< Indicates whether the chunks are currently written through f_direct_handle (1) or through the page cache (0) */
+
+  litl_data_t allow_io_uring; /**< Indicates whether each chunk and the offset that links it are written with a single io_uring submission (1) or with pwrite (0). By default, it is deactivated */
+  litl_data_t is_io_uring; /**< Indicates whether io_uring is currently used (1) or was found unsupported (0) */
+
+  litl_data_t allow_mapped_output; /**< Indicates whether the events are recorded directly in a mapping of the trace file (1) or in memory buffers (0). By default, it is deactivated */
+  size_t chunk_alignment; /**< The alignment of the chunks and of their sizes in the trace file and in memory, or 0 without direct I/O and mapped output */
+
+  litl_data_t allow_footer_index; /**< Indicates whether the threads and their chunks are listed in a footer index (1) or linked within the trace file (0). By default, it is deactivated */
+  litl_size_t footer_checkpoint; /**< A number of written chunks between two checkpoints of the footer index, or 0 to write it only when the trace is finalized */
+  litl_footer_entry_t* footer_threads; /**< The threads of the footer index */
+  litl_size_t nb_footer_threads; /**< A number of threads in the footer index */
+  litl_size_t nb_unsaved_chunks; /**< A number of chunks written since the last checkpoint of the footer index */
+  pthread_mutex_t lock_footer; /**< Protects the footer index */
+
+  litl_data_t allow_numa; /**< Indicates whether the buffers are bound to the NUMA node of their thread (1) or not (0). By default, it is deactivated */
+  litl_med_size_t numa_pool_size; /**< A maximum number of buffers kept in the pool of each NUMA node. By default, it is 0 */
+  litl_numa_pool_t numa_pools[LITL_MAX_NUMA_NODES]; /**< The pools of buffers of the NUMA nodes */
+  litl_data_t is_numa_pool_filled; /**< Indicates whether the pools were filled with their first buffers */
+  pthread_mutex_t lock_numa_pools; /**< Protects the pools of buffers */
+
+  litl_buffer_t* prealloc_buffers; /**< Buffers allocated before the threads register, which the threads that are not bound to NUMA nodes take first */
+  size_t nb_prealloc_buffers; /**< A number of preallocated buffers that are ready to be used */
+  size_t prealloc_size; /**< A maximum number of preallocated buffers. The buffers of the threads that exit go back to them */
+  size_t prealloc_length; /**< A size of the memory of the preallocated buffers */
+
+  litl_data_t allow_string_table; /**< Indicates whether the data of raw events are stored once in a string table (1) or in each event (0). By default, it is deactivated */
+  litl_string_slot_t* strings; /**< The string table: a hash table with open addressing of LITL_STRING_TABLE_SIZE slots, or NULL until the first string is added */
+  litl_string_id_t nb_strings; /**< A number of strings in the string table */
 } litl_write_trace_t;
 
+/**
+ * \ingroup litl_types_write
+ * \brief The argument of a thread created by litl_write_create_thread
+ */
+typedef struct {
+  litl_write_trace_t* trace; /**< A pointer to the trace that the thread registers to */
+  void* (*start_routine)(void*); /**< The function that the thread runs once it is registered */
+  void* arg; /**< The argument of start_routine */
+} litl_write_thread_start_t;
+
 /**
  * \ingroup litl_types_read
  * \brief A data structure for reading one event
@@ -361,6 +843,21 @@ typedef struct {
   litl_offset_t tracker; /**< An indicator of the end of the buffer, which equals to offset + buffer_size */
 
   litl_read_event_t cur_event; /**< The current event */
+
+  litl_time_t time; /**< The time of the current event (delta-encoded timestamps only) */
+  litl_buffer_t event_buffer; /**< The current event with its full time and its decoded parameters (delta-encoded timestamps or variable-length parameters only) */
+  litl_buffer_t block_ptr; /**< A buffer that stores the compressed block of events (compressed traces only) */
+
+  int f_handle; /**< A file handler of the file that stores the events of the thread */
+
+  litl_offset_t* chunks; /**< The offsets of the chunks of the thread (footer index only) */
+  litl_size_t nb_chunks; /**< A number of chunks of the thread */
+  litl_size_t cur_chunk; /**< An index of the current chunk */
+
+  litl_buffer_t string_event; /**< The current raw event rebuilt from its string id (string table only) */
+  litl_size_t string_event_size; /**< A size of the memory of string_event */
+  litl_buffer_t string_fragments; /**< The fragments of a string that does not fit in a buffer, until its end is read */
+  litl_size_t string_fragments_size; /**< A size of the fragments read so far */
 } litl_read_thread_t;
 
 /**
@@ -377,6 +874,10 @@ typedef struct {
 
   int cur_index; /**< An index of the current thread */
   int is_initialized; /**< Indicates that the process was initialized */
+
+  litl_buffer_t* strings; /**< The strings of the string table read so far, indexed by their id (string table only) */
+  litl_size_t* string_sizes; /**< The sizes of the strings */
+  litl_string_id_t max_strings; /**< A number of ids that strings can hold */
 } litl_read_process_t;
 
 /**
@@ -386,6 +887,7 @@ typedef struct {
  */
 typedef struct {
   int f_handle; /**< A file handler */
+  char* filename; /**< A file name */
 
   litl_general_header_t* header; /**< A pointer to the trace header */
   litl_buffer_t header_buffer_ptr; /**< A pointer to the beginning of the header buffer */
@@ -459,4 +961,19 @@ typedef struct {
  */
 #define LITL_BASE_SIZE __litl_offset_of(litl_t, parameters)
 
+/*
+ * For internal use only.
+ * With delta-encoded timestamps, an event is stored as a litl_t without its
+ *   first LITL_DELTA_SHIFT bytes: the remaining bytes of the time field store
+ *   the litl_time_delta_t
+ */
+#define LITL_DELTA_SHIFT (sizeof(litl_time_t) - sizeof(litl_time_delta_t))
+
+/*
+ * For internal use only.
+ * The largest time difference that can be stored in an event. Longer
+ *   intervals are stored in a time synchronization event
+ */
+#define LITL_TIME_DELTA_MAX ((litl_time_delta_t) -1)
+
 #endif /* LITL_TYPES_H_ */
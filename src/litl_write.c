@@ -16,60 +16,179 @@
 #include <errno.h>
 #include <assert.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <linux/io_uring.h>
+#endif
 
 #include "litl_timer.h"
 #include "litl_tools.h"
 #include "litl_write.h"
 #include "litl_config.h"
 
+static size_t __litl_write_get_buffer_length(litl_write_trace_t* trace);
+static void __litl_write_release_thread(void* arg);
+
+/*
+ * Identifiers of the trace objects. A trace may be allocated at the address
+ *   of a finalized one, so the thread-local cache is keyed by both
+ */
+static litl_size_t __litl_write_generation = 0;
+
+/*
+ * A thread-local cache of the thread buffer of the last trace that was used
+ *   by the thread. It avoids pthread_getspecific on every event and it is
+ *   also read by the inline probes of litl_write.h
+ */
+__thread litl_write_thread_cache_t __litl_write_thread_cache;
+
+/*
+ * Returns 1 if the threads and their chunks are listed in a footer index.
+ *   The per-thread files link their chunks as they only hold one thread
+ */
+static int __litl_write_has_footer_index(litl_write_trace_t* trace) {
+  return trace->allow_footer_index && !trace->allow_per_thread_files;
+}
+
+/*
+ * Returns whether the data of raw events are stored in the string table. The
+ *   flight recorder overwrites the definitions of the strings, so it keeps
+ *   the data in each event
+ */
+static int __litl_write_has_string_table(litl_write_trace_t* trace) {
+  return trace->allow_string_table && !trace->allow_ring_buffer;
+}
+
+/*
+ * Returns 1 if the events are recorded directly in a mapping of the trace
+ *   file. The chunks that are compressed, written by another thread or from
+ *   the shared pool, and those kept in memory need memory buffers
+ */
+static int __litl_write_has_mapped_output(litl_write_trace_t* trace) {
+  return trace->allow_mapped_output && !trace->allow_per_thread_files
+    && !trace->allow_ring_buffer && !trace->allow_async_flush
+    && !trace->allow_direct_io && !trace->codec && !trace->chunk_size
+    && trace->hugepages == LITL_HUGEPAGES_NONE;
+}
+
+/*
+ * Returns the format options stored in the process header
+ */
+static litl_size_t __litl_write_get_process_flags(litl_write_trace_t* trace) {
+  litl_size_t flags = 0;
+  if (trace->allow_per_thread_files)
+    flags |= LITL_FLAG_PER_THREAD_FILES;
+  if (trace->allow_delta_time)
+    flags |= LITL_FLAG_DELTA_TIME;
+  if (trace->allow_varint_params)
+    flags |= LITL_FLAG_VARINT_PARAMS;
+  if (trace->codec)
+    flags |= LITL_FLAG_COMPRESSED;
+  if (__litl_write_has_footer_index(trace))
+    flags |= LITL_FLAG_FOOTER_INDEX;
+  if (__litl_write_has_string_table(trace))
+    flags |= LITL_FLAG_STRING_TABLE;
+  return flags;
+}
+
+/*
+ * Returns the number of bytes that are omitted at the beginning of each
+ *   event stored in the buffers
+ */
+static litl_size_t __litl_write_get_delta_shift(litl_write_trace_t* trace) {
+  return trace->allow_delta_time ? LITL_DELTA_SHIFT : 0;
+}
+
+/*
+ * Fills the header of an event stored at pos and returns the event. With
+ *   delta-encoded timestamps, the event starts LITL_DELTA_SHIFT bytes before
+ *   pos and only the end of its time field, i.e. the delta, is written
+ */
+static litl_t* __litl_write_fill_event_header(litl_write_trace_t* trace,
+					      litl_buffer_t pos,
+					      litl_time_t time,
+					      litl_code_t code,
+					      litl_type_t type) {
+  litl_t* cur_ptr;
+
+  if (trace->allow_delta_time) {
+    cur_ptr = (litl_t *) (pos - LITL_DELTA_SHIFT);
+    *(litl_time_delta_t *) pos = time;
+  } else {
+    cur_ptr = (litl_t *) pos;
+    cur_ptr->time = time;
+  }
+  cur_ptr->code = code;
+  cur_ptr->type = type;
+
+  return cur_ptr;
+}
+
 /*
- * Adds a header to the trace file with the information regarding:
+ * Fills the general and the process-specific headers with the information
+ *   regarding:
  *   - OS
  *   - Processor type
  *   - Version of LiTL
  */
-static void __litl_write_add_trace_header(litl_write_trace_t* trace) {
+static void __litl_write_fill_trace_header(litl_write_trace_t* trace,
+					   litl_buffer_t header,
+					   litl_med_size_t nb_threads,
+					   litl_size_t flags) {
   struct utsname uts;
 
-  // allocate memory for the trace header
-  trace->header_ptr = (litl_buffer_t) malloc(trace->header_size);
-  printf("header_ptr=%p\n", trace->header_ptr);
-  if (!trace->header_ptr) {
-    perror("Could not allocate memory for the trace header!");
-    exit(EXIT_FAILURE);
-  }
-  trace->header = trace->header_ptr;
-  memset(trace->header_ptr, 0, trace->header_size);
   if (uname(&uts) < 0)
     perror("Could not use uname()!");
 
   // add a general header
   // version of LiTL
-  sprintf((char*) ((litl_general_header_t *) trace->header)->litl_ver, "%s",
+  sprintf((char*) ((litl_general_header_t *) header)->litl_ver, "%s",
 	  VERSION);
   // system information
-  sprintf((char*) ((litl_general_header_t *) trace->header)->sysinfo,
+  sprintf((char*) ((litl_general_header_t *) header)->sysinfo,
 	  "%s %s %s %s %s", uts.sysname, uts.nodename, uts.release, uts.version,
 	  uts.machine);
   // a number of processes
-  ((litl_general_header_t *) trace->header)->nb_processes = 1;
+  ((litl_general_header_t *) header)->nb_processes = 1;
   // move pointer
-  trace->header += sizeof(litl_general_header_t);
-  printf("adding %d bytes -> %p\n", sizeof(litl_general_header_t), trace->header);
+  header += sizeof(litl_general_header_t);
 
   // add a process-specific header
   // by default one trace file contains events only of one process
   char* filename = strrchr(trace->filename, '/');
-  filename++;
-  sprintf((char*) ((litl_process_header_t *) trace->header)->process_name, "%s",
+  filename = filename ? filename + 1 : trace->filename;
+  sprintf((char*) ((litl_process_header_t *) header)->process_name, "%s",
 	  filename);
-  ((litl_process_header_t *) trace->header)->nb_threads = trace->nb_threads;
-  ((litl_process_header_t *) trace->header)->header_nb_threads =
-    trace->nb_threads;
-  ((litl_process_header_t *) trace->header)->buffer_size = trace->buffer_size;
-  ((litl_process_header_t *) trace->header)->trace_size = 0;
-  ((litl_process_header_t *) trace->header)->offset =
+  ((litl_process_header_t *) header)->nb_threads = nb_threads;
+  ((litl_process_header_t *) header)->header_nb_threads = nb_threads;
+  ((litl_process_header_t *) header)->buffer_size = trace->buffer_size;
+  ((litl_process_header_t *) header)->trace_size = 0;
+  ((litl_process_header_t *) header)->offset =
     sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
+  ((litl_process_header_t *) header)->flags = flags;
+}
+
+/*
+ * Adds a header to the trace file
+ */
+static void __litl_write_add_trace_header(litl_write_trace_t* trace) {
+  // allocate memory for the trace header
+  trace->header_ptr = (litl_buffer_t) malloc(trace->header_size);
+  printf("header_ptr=%p\n", trace->header_ptr);
+  if (!trace->header_ptr) {
+    perror("Could not allocate memory for the trace header!");
+    exit(EXIT_FAILURE);
+  }
+  trace->header = trace->header_ptr;
+  memset(trace->header_ptr, 0, trace->header_size);
+
+  __litl_write_fill_trace_header(trace, trace->header,
+				 trace->nb_flushed_threads,
+				 __litl_write_get_process_flags(trace));
+  // move pointer
+  trace->header += sizeof(litl_general_header_t);
+  printf("adding %d bytes -> %p\n", sizeof(litl_general_header_t), trace->header);
 
   // header_size stores the position of nb_threads in the trace file
   trace->header_size = sizeof(litl_general_header_t)
@@ -80,6 +199,173 @@ static void __litl_write_add_trace_header(litl_write_trace_t* trace) {
   printf("adding %d bytes -> %p\n", sizeof(litl_process_header_t), trace->header);
 }
 
+/*
+ * Finds the segment of the buffer table and the position within the segment
+ *   of a thread-specific buffer. Segment k stores
+ *   LITL_BUFFER_SEGMENT_SIZE * 2^k buffers
+ */
+static inline void __litl_write_locate_buffer(litl_med_size_t index,
+					      litl_med_size_t* segment,
+					      litl_med_size_t* pos) {
+  litl_med_size_t q = index / LITL_BUFFER_SEGMENT_SIZE + 1;
+  *segment = 31 - __builtin_clz(q);
+  *pos = index - LITL_BUFFER_SEGMENT_SIZE * ((1U << *segment) - 1);
+}
+
+/*
+ * Returns the buffer of a given thread. The segment that contains it must
+ *   already be allocated
+ */
+static inline litl_write_buffer_t* __litl_write_get_thread_buffer(
+    litl_write_trace_t* trace, litl_med_size_t index) {
+  litl_med_size_t segment, pos;
+  __litl_write_locate_buffer(index, &segment, &pos);
+  return &trace->buffer_segments[segment][pos];
+}
+
+/*
+ * Returns the buffer of a given thread if the thread finished its
+ *   registration, NULL otherwise
+ */
+static litl_write_buffer_t* __litl_write_get_registered_buffer(
+    litl_write_trace_t* trace, litl_med_size_t index) {
+  litl_med_size_t segment, pos;
+  litl_write_buffer_t* p_segment;
+
+  __litl_write_locate_buffer(index, &segment, &pos);
+  p_segment = __atomic_load_n(&trace->buffer_segments[segment],
+			      __ATOMIC_ACQUIRE);
+  if (!p_segment || !__atomic_load_n(&p_segment[pos].initialized,
+				     __ATOMIC_ACQUIRE))
+    return NULL;
+  return &p_segment[pos];
+}
+
+/*
+ * Allocates a segment of the buffer table, unless another thread already
+ *   did it
+ */
+static void __litl_write_alloc_buffer_segment(litl_write_trace_t* trace,
+					      litl_med_size_t segment) {
+  litl_write_buffer_t* expected = NULL;
+  litl_med_size_t i, size = LITL_BUFFER_SEGMENT_SIZE << segment;
+
+  if (segment >= LITL_NB_BUFFER_SEGMENTS) {
+    fprintf(stderr, "[LiTL] Too many threads!\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (__atomic_load_n(&trace->buffer_segments[segment], __ATOMIC_ACQUIRE))
+    return;
+
+  // the buffers are aligned on cache lines, and padded up to them
+  litl_write_buffer_t* p_segment;
+  if (posix_memalign((void **) &p_segment, LITL_CACHE_LINE_SIZE,
+		     size * sizeof(litl_write_buffer_t))) {
+    perror("Could not allocate memory for the threads!");
+    exit(EXIT_FAILURE);
+  }
+  memset(p_segment, 0, size * sizeof(litl_write_buffer_t));
+  for (i = 0; i < size; i++)
+    p_segment[i].f_handle = -1;
+
+  if (!__atomic_compare_exchange_n(&trace->buffer_segments[segment], &expected,
+				   p_segment, 0, __ATOMIC_ACQ_REL,
+				   __ATOMIC_ACQUIRE))
+    // another thread published the segment first
+    free(p_segment);
+}
+
+/*
+ * Sets or clears a state bit (LITL_CODE_*) of the codes between first and last
+ */
+static void __litl_write_set_code_state(litl_write_trace_t* trace,
+					litl_code_t first, litl_code_t last,
+					litl_data_t state, litl_data_t is_set) {
+  litl_code_t code;
+
+  if (!trace || first > last)
+    return;
+
+  // the codes from LITL_FILTER_NB_CODES share the last state
+  if (last > LITL_FILTER_NB_CODES)
+    last = LITL_FILTER_NB_CODES;
+  if (first > LITL_FILTER_NB_CODES)
+    first = LITL_FILTER_NB_CODES;
+
+  // the probes read the states without any lock
+  for (code = first; code <= last; code++) {
+    litl_data_t mask = state << (code % 4 * 2);
+    if (is_set)
+      __atomic_fetch_or(&trace->code_filter[code / 4], mask, __ATOMIC_RELAXED);
+    else
+      __atomic_fetch_and(&trace->code_filter[code / 4], ~mask,
+			 __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Parses a list of codes and ranges of codes, e.g. "0x100-0x1ff,0x300", and
+ *   enables or disables them
+ */
+static void __litl_write_filter_code_list(litl_write_trace_t* trace,
+					  const char* str,
+					  litl_data_t is_enabled) {
+  char* end;
+  litl_code_t first, last;
+
+  while (*str) {
+    first = strtoul(str, &end, 0);
+    last = first;
+    if (*end == '-')
+      last = strtoul(end + 1, &end, 0);
+    if (end == str || (*end && *end != ',')) {
+      fprintf(stderr, "[LiTL] Warning: invalid list of event codes: '%s'\n",
+	      str);
+      return;
+    }
+    __litl_write_set_code_state(trace, first, last, LITL_CODE_ENABLED,
+				is_enabled);
+    str = *end ? end + 1 : end;
+  }
+}
+
+/*
+ * Parses a list of sampling policies, e.g.
+ *   "0x100=one_in:100,0x200=max_rate:5,0x300=budget:1000000", and applies them
+ */
+static void __litl_write_sampling_list(litl_write_trace_t* trace,
+				       const char* str) {
+  static const char* policies[] = { "none", "one_in", "max_rate", "budget" };
+  char* end;
+  litl_code_t code;
+  litl_size_t value;
+  int policy;
+
+  while (*str) {
+    code = strtoul(str, &end, 0);
+    if (end == str || *end != '=')
+      goto error;
+    for (policy = LITL_SAMPLING_BUDGET; policy > LITL_SAMPLING_NONE; policy--)
+      if (strncmp(end + 1, policies[policy], strlen(policies[policy])) == 0
+	  && end[1 + strlen(policies[policy])] == ':')
+	break;
+    if (policy == LITL_SAMPLING_NONE)
+      goto error;
+    str = end + 2 + strlen(policies[policy]);
+    value = strtoul(str, &end, 0);
+    if (end == str || (*end && *end != ','))
+      goto error;
+    litl_write_set_sampling(trace, code, policy, value);
+    str = *end ? end + 1 : end;
+  }
+  return;
+
+ error:
+  fprintf(stderr, "[LiTL] Warning: invalid list of sampling policies: '%s'\n",
+	  str);
+}
+
 /*
  * Initializes the trace buffer
  */
@@ -95,9 +381,41 @@ litl_write_trace_t* litl_write_init_trace(const litl_size_t buf_size) {
 
   // set variables
   trace->filename = NULL;
+  trace->f_handle = -1;
   trace->general_offset = 0;
   trace->is_header_flushed = 0;
 
+  // the background flusher is started by the first full buffer. Its state is
+  //   set before the setters below, which check it
+  trace->flush_queue = NULL;
+  trace->flush_queue_head = 0;
+  trace->flush_queue_count = 0;
+  trace->is_flush_thread_running = 0;
+  trace->is_flush_thread_stopping = 0;
+  trace->nb_dropped_events = 0;
+  pthread_mutex_init(&trace->lock_flush_queue, NULL );
+  pthread_cond_init(&trace->flush_queue_cond, NULL );
+  pthread_cond_init(&trace->flush_done_cond, NULL );
+
+  // the pools of NUMA nodes are filled when the first thread starts
+  memset(trace->numa_pools, 0, sizeof(trace->numa_pools));
+  trace->is_numa_pool_filled = 0;
+  pthread_mutex_init(&trace->lock_numa_pools, NULL );
+  trace->prealloc_buffers = NULL;
+  trace->nb_prealloc_buffers = 0;
+  trace->prealloc_size = 0;
+  trace->prealloc_length = 0;
+
+  // the string table is allocated when the first string is added
+  trace->strings = NULL;
+  trace->nb_strings = 0;
+
+  // the chunk pool gets its first slab when a thread needs a chunk
+  trace->chunk_pool = NULL;
+  trace->chunk_slabs = NULL;
+  trace->nb_chunk_slabs = 0;
+  pthread_mutex_init(&trace->lock_chunk_pool, NULL );
+
   // set the buffer size using the environment variable.
   //   If the variable is not specified, use the provided value
   char* str = getenv("LITL_BUFFER_SIZE");
@@ -107,32 +425,37 @@ litl_write_trace_t* litl_write_init_trace(const litl_size_t buf_size) {
     trace->buffer_size = buf_size;
 
   trace->is_buffer_full = 0;
-  trace->nb_allocated_buffers = 256;
-  trace->buffers = malloc(
-      sizeof(litl_write_buffer_t*) * trace->nb_allocated_buffers);
-  if (!trace->buffers) {
-    perror("Could not allocate memory for the threads!");
-    exit(EXIT_FAILURE);
-  }
-
-  for (i = 0; i < trace->nb_allocated_buffers; i++) {
-    // initialize the array already_flushed
-    trace->buffers[i] = malloc(sizeof(litl_write_buffer_t));
-    if (!trace->buffers[i]) {
-      perror("Could not allocate memory for a thread\n");
-      exit(EXIT_FAILURE);
-    }
-    trace->buffers[i]->already_flushed = 0;
-
-    // initialize tids by zeros; this is needed for __is_tid and __find_slot
-    trace->buffers[i]->tid = 0;
-  }
+  // the first segment of the buffer table is allocated in advance, the
+  //   others when threads need them
+  for (i = 0; i < LITL_NB_BUFFER_SEGMENTS; i++)
+    trace->buffer_segments[i] = NULL;
+  __litl_write_alloc_buffer_segment(trace, 0);
   trace->nb_threads = 0;
+  trace->nb_flushed_threads = 0;
 
   // initialize the timing mechanism
   litl_time_initialize();
 
-  assert(pthread_key_create(&trace->index, NULL ) == 0);
+  // the buffers of the threads that exit are flushed and recycled
+  if (pthread_key_create(&trace->index, __litl_write_release_thread) != 0) {
+    perror("Could not create the private thread variable!");
+    exit(EXIT_FAILURE);
+  }
+  trace->free_slots = NULL;
+  trace->nb_free_slots = 0;
+  pthread_mutex_init(&trace->lock_free_slots, NULL );
+  trace->f_direct_handle = -1;
+  trace->is_direct_io = 0;
+  trace->allow_direct_io = 0;
+  trace->allow_mapped_output = 0;
+  trace->allow_io_uring = 0;
+  trace->is_io_uring = 0;
+  trace->footer_threads = NULL;
+  trace->nb_footer_threads = 0;
+  trace->nb_unsaved_chunks = 0;
+  pthread_mutex_init(&trace->lock_footer, NULL );
+  trace->generation = __atomic_add_fetch(&__litl_write_generation, 1,
+					 __ATOMIC_RELAXED);
 
   // set trace->allow_buffer_flush using the environment variable.
   //   By default the buffer flushing is disabled
@@ -154,7 +477,6 @@ litl_write_trace_t* litl_write_init_trace(const litl_size_t buf_size) {
 
   if (trace->allow_thread_safety)
     pthread_mutex_init(&trace->lock_litl_flush, NULL );
-  pthread_mutex_init(&trace->lock_buffer_init, NULL );
 
   // set trace->allow_tid_recording using the environment variable.
   //   By default tid recording is enabled
@@ -163,9 +485,167 @@ litl_write_trace_t* litl_write_init_trace(const litl_size_t buf_size) {
   if (str && (strcmp(str, "0") == 0))
     litl_write_tid_recording_off(trace);
 
+  // set the background flusher parameters using the environment variables.
+  //   By default buffers are flushed by the recording threads
+  litl_write_async_flush_off(trace);
+  str = getenv("LITL_ASYNC_FLUSH");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_async_flush_on(trace);
+
+  litl_write_set_nb_buffers(trace, 2);
+  str = getenv("LITL_NB_BUFFERS");
+  if (str)
+    litl_write_set_nb_buffers(trace, atoi(str));
+
+  litl_write_set_flush_queue_depth(trace, 16);
+  str = getenv("LITL_FLUSH_QUEUE_DEPTH");
+  if (str)
+    litl_write_set_flush_queue_depth(trace, atoi(str));
+
+  litl_write_set_flush_policy(trace, LITL_FLUSH_POLICY_BLOCK);
+  str = getenv("LITL_FLUSH_POLICY");
+  if (str && (strcmp(str, "drop") == 0))
+    litl_write_set_flush_policy(trace, LITL_FLUSH_POLICY_DROP);
+
+  // set trace->allow_per_thread_files using the environment variable.
+  //   By default all the threads write to the same file
+  litl_write_per_thread_files_off(trace);
+  str = getenv("LITL_PER_THREAD_FILES");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_per_thread_files_on(trace);
+
+  // set trace->allow_delta_time using the environment variable.
+  //   By default events store the full time
+  litl_write_delta_time_off(trace);
+  str = getenv("LITL_DELTA_TIME");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_delta_time_on(trace);
+
+  // set trace->allow_varint_params using the environment variable.
+  //   By default parameters are stored on litl_param_t
+  litl_write_varint_params_off(trace);
+  str = getenv("LITL_VARINT_PARAMS");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_varint_params_on(trace);
+
+  // set trace->allow_string_table using the environment variable.
+  //   By default raw events store their data
+  litl_write_string_table_off(trace);
+  str = getenv("LITL_STRING_TABLE");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_string_table_on(trace);
+
+  // set trace->codec using the environment variable.
+  //   By default chunks are not compressed
+  litl_write_set_codec(trace, NULL);
+  str = getenv("LITL_CODEC");
+  if (str && (strcmp(str, "none") != 0)) {
+    if (!litl_codec_find(str)) {
+      fprintf(stderr, "Unknown codec: '%s'\n", str);
+      abort();
+    }
+    litl_write_set_codec(trace, litl_codec_find(str));
+  }
+
+  // set trace->allow_direct_io using the environment variable.
+  //   By default the trace file is written through the page cache
+  litl_write_direct_io_off(trace);
+  str = getenv("LITL_DIRECT_IO");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_direct_io_on(trace);
+
+  // set trace->allow_io_uring using the environment variable.
+  //   By default the chunks are written with pwrite
+  litl_write_io_uring_off(trace);
+  str = getenv("LITL_IO_URING");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_io_uring_on(trace);
+
+  // set trace->allow_footer_index using the environment variables.
+  //   By default the chunks of each thread are linked within the trace file
+  litl_write_footer_index_off(trace);
+  str = getenv("LITL_FOOTER_INDEX");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_footer_index_on(trace);
+
+  litl_write_set_footer_checkpoint(trace, 256);
+  str = getenv("LITL_FOOTER_CHECKPOINT");
+  if (str)
+    litl_write_set_footer_checkpoint(trace, atoi(str));
+
+  // set trace->allow_mapped_output using the environment variable.
+  //   By default the events are recorded in memory buffers
+  litl_write_mapped_output_off(trace);
+  str = getenv("LITL_MAPPED_OUTPUT");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_mapped_output_on(trace);
+
+  // set trace->code_filter using the environment variables. By default all
+  //   the codes are recorded. LITL_ENABLED_CODES restricts the recording to
+  //   some codes, then LITL_DISABLED_CODES removes some codes
+  memset(trace->code_filter, 0x55, sizeof(trace->code_filter));
+  str = getenv("LITL_ENABLED_CODES");
+  if (str) {
+    litl_write_disable_codes(trace, 0, LITL_FILTER_NB_CODES);
+    __litl_write_filter_code_list(trace, str, 1);
+  }
+  str = getenv("LITL_DISABLED_CODES");
+  if (str)
+    __litl_write_filter_code_list(trace, str, 0);
+
+  // set trace->sampling_rules using the environment variable. By default
+  //   all the events are recorded
+  trace->nb_sampling_rules = 0;
+  str = getenv("LITL_SAMPLING");
+  if (str)
+    __litl_write_sampling_list(trace, str);
+  litl_write_set_keymask(trace, (uint32_t) -1);
+
+  // set trace->allow_ring_buffer using the environment variable.
+  //   By default the events are written to the trace file
+  litl_write_ring_buffer_off(trace);
+  str = getenv("LITL_RING_BUFFER");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_ring_buffer_on(trace);
+
+  // set trace->allow_numa and trace->numa_pool_size using the environment
+  //   variables. By default the buffers are not bound to NUMA nodes
+  litl_write_numa_off(trace);
+  str = getenv("LITL_NUMA");
+  if (str && (strcmp(str, "0") != 0))
+    litl_write_numa_on(trace);
+
+  litl_write_set_numa_pool_size(trace, 0);
+  str = getenv("LITL_NUMA_POOL");
+  if (str)
+    litl_write_set_numa_pool_size(trace, atoi(str));
+
+  // set trace->chunk_size using the environment variable.
+  //   By default each thread has its own buffer
+  litl_write_set_chunk_size(trace, 0);
+  str = getenv("LITL_CHUNK_SIZE");
+  if (str)
+    litl_write_set_chunk_size(trace, atoi(str));
+
+  // set trace->hugepages using the environment variable.
+  //   By default the buffers are backed by regular pages
+  litl_write_set_hugepages(trace, LITL_HUGEPAGES_NONE);
+  str = getenv("LITL_HUGEPAGES");
+  if (str && (strcmp(str, "thp") == 0))
+    litl_write_set_hugepages(trace, LITL_HUGEPAGES_THP);
+  else if (str && (strcmp(str, "hugetlb") == 0))
+    litl_write_set_hugepages(trace, LITL_HUGEPAGES_HUGETLB);
+
   trace->is_recording_paused = 0;
   trace->is_litl_initialized = 1;
 
+  // preallocate the buffers of some threads using the environment variable,
+  //   once the other options are set. By default the buffers are allocated
+  //   by the first event of each thread
+  str = getenv("LITL_PREALLOC_THREADS");
+  if (str)
+    litl_write_prealloc_threads(trace, atoi(str));
+
   return trace;
 }
 
@@ -176,12 +656,33 @@ static litl_size_t __litl_write_get_header_size(litl_write_trace_t* trace) {
   return (trace->header - trace->header_ptr);
 }
 
+/*
+ * Returns the size of a range of the trace file that holds size Bytes. With
+ *   direct I/O, it is a multiple of the alignment
+ */
+static litl_size_t __litl_write_get_aligned_size(litl_write_trace_t* trace,
+						 litl_size_t size) {
+  if (trace->chunk_alignment)
+    size = (size + trace->chunk_alignment - 1) / trace->chunk_alignment
+      * trace->chunk_alignment;
+  return size;
+}
+
 /*
  * Computes the size of data in buffer
  */
 static litl_size_t __litl_write_get_buffer_size(litl_write_trace_t* trace,
 						litl_med_size_t pos) {
-  return (trace->buffers[pos]->buffer - trace->buffers[pos]->buffer_ptr);
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, pos);
+  return (p_buffer->buffer - p_buffer->buffer_ptr);
+}
+
+/*
+ * Returns the number of Bytes of events that a thread buffer holds: a chunk
+ *   with the chunk pool, the whole buffer otherwise
+ */
+static litl_size_t __litl_write_get_buffer_capacity(litl_write_trace_t* trace) {
+  return trace->chunk_size ? trace->chunk_size : trace->buffer_size;
 }
 
 /*
@@ -227,131 +728,655 @@ void litl_write_tid_recording_off(litl_write_trace_t* trace) {
 }
 
 /*
- * Pauses the event recording
+ * Activates the background flusher
  */
-void litl_write_pause_recording(litl_write_trace_t* trace) {
-  if (trace)
-    trace->is_recording_paused = 1;
+void litl_write_async_flush_on(litl_write_trace_t* trace) {
+  trace->allow_async_flush = 1;
 }
 
 /*
- * Resumes the event recording
+ * Deactivates the background flusher. By default, it is deactivated
  */
-void litl_write_resume_recording(litl_write_trace_t* trace) {
-  if (trace)
-    trace->is_recording_paused = 0;
+void litl_write_async_flush_off(litl_write_trace_t* trace) {
+  trace->allow_async_flush = 0;
 }
 
 /*
- * Sets a new name for the trace file
+ * Sets the number of buffers per thread used with the background flusher
  */
-void litl_write_set_filename(litl_write_trace_t* trace, char* filename) {
-  if (trace->filename) {
-    if (trace->is_header_flushed)
-      fprintf(
-	  stderr,
-	  "Warning: changing the trace file name to %s after some events have been saved in file %s\n",
-	  filename, trace->filename);
-    free(trace->filename);
+void litl_write_set_nb_buffers(litl_write_trace_t* trace,
+			       litl_med_size_t nb_buffers) {
+  if (nb_buffers < 2) {
+    fprintf(stderr, "[LiTL] Warning: at least 2 buffers per thread are needed by the background flusher\n");
+    nb_buffers = 2;
   }
+  trace->nb_buffers = nb_buffers;
+}
 
-  // check whether the file name was set. If no, set it by default trace name.
-  if (filename == NULL )
-    sprintf(filename, "/tmp/%s_%s", getenv("USER"), "litl_log_1");
-
-  if (asprintf(&trace->filename, "%s", filename) == -1) {
-    perror("Error: Cannot set the filename for recording events!\n");
-    exit(EXIT_FAILURE);
+/*
+ * Sets the maximum number of full buffers waiting to be written
+ */
+void litl_write_set_flush_queue_depth(litl_write_trace_t* trace,
+				      litl_med_size_t depth) {
+  if (trace->flush_queue) {
+    fprintf(stderr, "[LiTL] Warning: cannot change the flush queue depth once the background flusher is running\n");
+    return;
   }
+  if (depth < 1)
+    depth = 1;
+  trace->flush_queue_depth = depth;
 }
 
 /*
- * Records an event with offset only
+ * Selects what recording threads do when the background flusher falls behind
  */
-static void __litl_write_probe_offset(litl_write_trace_t* trace,
-				      litl_med_size_t index) {
-  if (!trace->is_litl_initialized || trace->is_recording_paused)
-    return;
+void litl_write_set_flush_policy(litl_write_trace_t* trace,
+				 litl_flush_policy_t policy) {
+  trace->flush_policy = policy;
+}
 
-  litl_t* cur_ptr = (litl_t *) trace->buffers[index]->buffer;
-  cur_ptr->time = 0;
-  cur_ptr->code = LITL_OFFSET_CODE;
-  cur_ptr->type = LITL_TYPE_REGULAR;
-  cur_ptr->parameters.offset.nb_params = 1;
-  cur_ptr->parameters.offset.offset = 0;
+/*
+ * Activates per-thread trace files
+ */
+void litl_write_per_thread_files_on(litl_write_trace_t* trace) {
+  if (trace->is_header_flushed) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to per-thread trace files after some events have been saved in file %s\n",
+	    trace->filename);
+    return;
+  }
+  trace->allow_per_thread_files = 1;
+}
 
-  trace->buffers[index]->buffer += __litl_get_gen_event_size(cur_ptr);
+/*
+ * Deactivates per-thread trace files. By default, they are deactivated
+ */
+void litl_write_per_thread_files_off(litl_write_trace_t* trace) {
+  trace->allow_per_thread_files = 0;
 }
 
-/* Open the trace file. If the file already exists, delete it first
+/*
+ * Activates delta-encoded timestamps
  */
-static void __litl_open_new_file(litl_write_trace_t* trace) {
-  /* if file exist. delete it first */
-  if ((trace->f_handle = open(trace->filename, O_WRONLY | O_CREAT | O_EXCL, 0644))
-      < 0) {
+void litl_write_delta_time_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to delta-encoded timestamps after some events have been recorded\n");
+    return;
+  }
+  trace->allow_delta_time = 1;
+}
 
-    if(errno == EEXIST) {
-      /* file already exist. Delete it and open it */
-      if(unlink(trace->filename) < 0 ){
-	perror("Cannot delete trace file");
-	exit(EXIT_FAILURE);
-      }
-      if ((trace->f_handle = open(trace->filename, O_WRONLY | O_CREAT | O_EXCL, 0644))
-	  < 0) {
-	perror("Cannot open trace file");
-	exit(EXIT_FAILURE);
-      }
-     } else {
-      fprintf(stderr, "Cannot open %s\n", trace->filename);
-      exit(EXIT_FAILURE);
-    }
+/*
+ * Deactivates delta-encoded timestamps. By default, they are deactivated
+ */
+void litl_write_delta_time_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to full timestamps after some events have been recorded\n");
+    return;
   }
+  trace->allow_delta_time = 0;
 }
 
 /*
- * Write the header on the disk
+ * Activates variable-length parameters
  */
-static void __litl_write_update_header(litl_write_trace_t* trace) {
-  // write the trace header to the trace file
-  assert(trace->f_handle >= 0);
-  lseek(trace->f_handle, 0, SEEK_SET);
+void litl_write_varint_params_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to variable-length parameters after some events have been recorded\n");
+    return;
+  }
+  trace->allow_varint_params = 1;
+}
 
-  if (write(trace->f_handle, trace->header_ptr,
-	    __litl_write_get_header_size(trace)) == -1) {
-    perror(
-	   "Flushing the buffer. Could not write measured data to the trace file!");
-    exit(EXIT_FAILURE);
+/*
+ * Deactivates variable-length parameters. By default, they are deactivated
+ */
+void litl_write_varint_params_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to fixed-length parameters after some events have been recorded\n");
+    return;
   }
+  trace->allow_varint_params = 0;
 }
 
 /*
- * Update the header and flush it to disk
+ * Activates the string table
  */
-static void __litl_write_flush_header(litl_write_trace_t* trace) {
+void litl_write_string_table_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to the string table after some events have been recorded\n");
+    return;
+  }
+  trace->allow_string_table = 1;
+}
 
-  if (!trace->is_header_flushed) {
-    // open the trace file
-    __litl_open_new_file(trace);
+/*
+ * Deactivates the string table. By default, it is deactivated
+ */
+void litl_write_string_table_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to raw data after some events have been recorded\n");
+    return;
+  }
+  trace->allow_string_table = 0;
+}
+
+/*
+ * Aligns the chunks on pages when they are written with direct I/O or
+ *   mapped: a page is at least as large as the logical blocks of the
+ *   devices, and the chunks of different threads never share a page of the
+ *   page cache
+ */
+static void __litl_write_set_chunk_alignment(litl_write_trace_t* trace) {
+  if (trace->allow_direct_io || trace->allow_mapped_output)
+    trace->chunk_alignment = sysconf(_SC_PAGESIZE);
+  else
+    trace->chunk_alignment = 0;
+}
+
+/*
+ * Activates direct I/O
+ */
+void litl_write_direct_io_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to direct I/O after some events have been recorded\n");
+    return;
+  }
+  trace->allow_direct_io = 1;
+  __litl_write_set_chunk_alignment(trace);
+}
+
+/*
+ * Deactivates direct I/O. By default, it is deactivated
+ */
+void litl_write_direct_io_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to buffered I/O after some events have been recorded\n");
+    return;
+  }
+  trace->allow_direct_io = 0;
+  __litl_write_set_chunk_alignment(trace);
+}
+
+/*
+ * Activates io_uring
+ */
+void litl_write_io_uring_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to io_uring after some events have been recorded\n");
+    return;
+  }
+  trace->allow_io_uring = 1;
+  trace->is_io_uring = 1;
+}
+
+/*
+ * Deactivates io_uring. By default, it is deactivated
+ */
+void litl_write_io_uring_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to pwrite after some events have been recorded\n");
+    return;
+  }
+  trace->allow_io_uring = 0;
+  trace->is_io_uring = 0;
+}
+
+/*
+ * Activates the mapped output
+ */
+void litl_write_mapped_output_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to the mapped output after some events have been recorded\n");
+    return;
+  }
+  trace->allow_mapped_output = 1;
+  __litl_write_set_chunk_alignment(trace);
+}
+
+/*
+ * Deactivates the mapped output. By default, it is deactivated
+ */
+void litl_write_mapped_output_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to memory buffers after some events have been recorded\n");
+    return;
+  }
+  trace->allow_mapped_output = 0;
+  __litl_write_set_chunk_alignment(trace);
+}
+
+/*
+ * Activates the footer index
+ */
+void litl_write_footer_index_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to the footer index after some events have been recorded\n");
+    return;
+  }
+  trace->allow_footer_index = 1;
+}
+
+/*
+ * Deactivates the footer index. By default, it is deactivated
+ */
+void litl_write_footer_index_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot switch to linked chunks after some events have been recorded\n");
+    return;
+  }
+  trace->allow_footer_index = 0;
+}
+
+/*
+ * Sets the number of chunks written between two checkpoints of the footer
+ *   index
+ */
+void litl_write_set_footer_checkpoint(litl_write_trace_t* trace,
+				      litl_size_t nb_chunks) {
+  pthread_mutex_lock(&trace->lock_footer);
+  trace->footer_checkpoint = nb_chunks;
+  pthread_mutex_unlock(&trace->lock_footer);
+}
+
+/*
+ * Selects the codec that compresses the chunks of events
+ */
+void litl_write_set_codec(litl_write_trace_t* trace,
+			  const litl_codec_t* codec) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot change the codec after some events have been recorded\n");
+    return;
+  }
+  trace->codec = codec;
+}
+
+/*
+ * Activates the flight-recorder mode
+ */
+void litl_write_ring_buffer_on(litl_write_trace_t* trace) {
+  trace->allow_ring_buffer = 1;
+}
+
+/*
+ * Deactivates the flight-recorder mode. By default, it is deactivated
+ */
+void litl_write_ring_buffer_off(litl_write_trace_t* trace) {
+  trace->allow_ring_buffer = 0;
+}
+
+/*
+ * Activates the NUMA placement of the buffers
+ */
+void litl_write_numa_on(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot bind the buffers to NUMA nodes after some events have been recorded\n");
+    return;
+  }
+  trace->allow_numa = 1;
+}
+
+/*
+ * Deactivates the NUMA placement of the buffers. By default, it is deactivated
+ */
+void litl_write_numa_off(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot unbind the buffers from NUMA nodes after some events have been recorded\n");
+    return;
+  }
+  trace->allow_numa = 0;
+}
+
+/*
+ * Sets the maximum number of buffers kept in the pool of each NUMA node
+ */
+void litl_write_set_numa_pool_size(litl_write_trace_t* trace,
+				   litl_med_size_t pool_size) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot change the size of the NUMA pools after some events have been recorded\n");
+    return;
+  }
+  trace->numa_pool_size = pool_size;
+}
+
+/*
+ * Sets the size of the chunks of the shared pool
+ */
+void litl_write_set_chunk_size(litl_write_trace_t* trace,
+			       litl_size_t chunk_size) {
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot change the chunk size after some events have been recorded\n");
+    return;
+  }
+  if (chunk_size > trace->buffer_size) {
+    fprintf(stderr, "[LiTL] Warning: the chunks cannot be larger than the buffer size\n");
+    chunk_size = trace->buffer_size;
+  }
+  trace->chunk_size = chunk_size;
+}
+
+/*
+ * Selects the kind of pages that back the buffers
+ */
+void litl_write_set_hugepages(litl_write_trace_t* trace,
+			      litl_hugepages_t hugepages) {
+  char str[128];
+  unsigned long size;
+  FILE* f;
+
+  if (__atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE) > 0) {
+    fprintf(stderr, "[LiTL] Warning: cannot change the pages of the buffers after some events have been recorded\n");
+    return;
+  }
+  trace->hugepages = hugepages;
+  trace->hugepages_obtained = hugepages;
+
+  // the buffers are rounded up to the default size of huge pages
+  trace->hugepage_size = 2 * 1024 * 1024;
+  if (hugepages == LITL_HUGEPAGES_NONE)
+    return;
+  f = fopen("/proc/meminfo", "r");
+  if (f) {
+    while (fgets(str, sizeof(str), f))
+      if (sscanf(str, "Hugepagesize: %lu kB", &size) == 1 && size > 0) {
+	trace->hugepage_size = size * 1024;
+	break;
+      }
+    fclose(f);
+  }
+}
+
+/*
+ * Returns the kind of pages that back the buffers
+ */
+litl_hugepages_t litl_write_get_hugepages(litl_write_trace_t* trace) {
+  return __atomic_load_n(&trace->hugepages_obtained, __ATOMIC_RELAXED);
+}
+
+/*
+ * Pauses the event recording
+ */
+void litl_write_pause_recording(litl_write_trace_t* trace) {
+  if (trace)
+    trace->is_recording_paused = 1;
+}
+
+/*
+ * Resumes the event recording
+ */
+void litl_write_resume_recording(litl_write_trace_t* trace) {
+  if (trace)
+    trace->is_recording_paused = 0;
+}
+
+/*
+ * Enables the recording of the codes between first and last
+ */
+void litl_write_enable_codes(litl_write_trace_t* trace, litl_code_t first,
+			     litl_code_t last) {
+  __litl_write_set_code_state(trace, first, last, LITL_CODE_ENABLED, 1);
+}
+
+/*
+ * Disables the recording of the codes between first and last
+ */
+void litl_write_disable_codes(litl_write_trace_t* trace, litl_code_t first,
+			      litl_code_t last) {
+  __litl_write_set_code_state(trace, first, last, LITL_CODE_ENABLED, 0);
+}
+
+/*
+ * Sets the sampling policy of an event code
+ */
+int litl_write_set_sampling(litl_write_trace_t* trace, litl_code_t code,
+			    litl_sampling_policy_t policy, litl_size_t value) {
+  litl_med_size_t i;
+
+  if (!trace || (policy != LITL_SAMPLING_NONE && value == 0))
+    return -1;
+
+  for (i = 0; i < trace->nb_sampling_rules; i++)
+    if (trace->sampling_rules[i].code == code)
+      break;
+
+  if (i == trace->nb_sampling_rules) {
+    if (policy == LITL_SAMPLING_NONE)
+      return 0;
+    if (i == LITL_MAX_SAMPLING_RULES) {
+      fprintf(stderr, "[LiTL] Warning: cannot sample more than %d event codes\n",
+	      LITL_MAX_SAMPLING_RULES);
+      return -1;
+    }
+    // the recording threads look for the rules without any lock, so the
+    //   rule is published once it is complete
+    trace->sampling_rules[i].code = code;
+    trace->sampling_rules[i].policy = policy;
+    trace->sampling_rules[i].value = value;
+    __atomic_store_n(&trace->nb_sampling_rules, i + 1, __ATOMIC_RELEASE);
+  } else {
+    __atomic_store_n(&trace->sampling_rules[i].value, value, __ATOMIC_RELAXED);
+    __atomic_store_n(&trace->sampling_rules[i].policy, policy,
+		     __ATOMIC_RELEASE);
+  }
+
+  // the codes from LITL_FILTER_NB_CODES share the same state, which stays
+  //   sampled: their rules are looked up by code
+  if (code < LITL_FILTER_NB_CODES || policy != LITL_SAMPLING_NONE)
+    __litl_write_set_code_state(trace, code, code, LITL_CODE_SAMPLED,
+				policy != LITL_SAMPLING_NONE);
+
+  return 0;
+}
+
+/*
+ * Sets the mask of the enabled FxT event classes
+ */
+void litl_write_set_keymask(litl_write_trace_t* trace, uint32_t keymask) {
+  if (trace)
+    trace->keymask = keymask;
+}
+
+/*
+ * Sets a new name for the trace file
+ */
+void litl_write_set_filename(litl_write_trace_t* trace, char* filename) {
+  if (trace->filename) {
+    if (trace->is_header_flushed)
+      fprintf(
+	  stderr,
+	  "Warning: changing the trace file name to %s after some events have been saved in file %s\n",
+	  filename, trace->filename);
+    free(trace->filename);
+  }
+
+  // check whether the file name was set. If no, set it by default trace name.
+  if (filename == NULL )
+    sprintf(filename, "/tmp/%s_%s", getenv("USER"), "litl_log_1");
+
+  if (asprintf(&trace->filename, "%s", filename) == -1) {
+    perror("Error: Cannot set the filename for recording events!\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Writes at pos the sampling counters of a thread: one event per sampled code
+ *   whose counters changed since they were last recorded, or per sampled code
+ *   with events when the chunk is copied by a dump. Returns the size of the
+ *   events, which fit in the space reserved after the buffer
+ */
+static litl_size_t __litl_write_fill_sampling_counters(
+    litl_write_trace_t* trace, litl_write_buffer_t* p_buffer,
+    litl_buffer_t pos, litl_data_t is_dump) {
+  litl_med_size_t i, nb_rules;
+  litl_sampling_state_t* state;
+  litl_buffer_t start = pos;
+  litl_t* cur_ptr;
+
+  if (!p_buffer->sampling)
+    return 0;
+
+  nb_rules = __atomic_load_n(&trace->nb_sampling_rules, __ATOMIC_ACQUIRE);
+  for (i = 0; i < nb_rules; i++) {
+    state = &p_buffer->sampling[i];
+    if (state->nb_events == 0
+	|| (!is_dump && state->nb_reported_events == state->nb_events))
+      continue;
+
+    // the counters get the time of the last event of the chunk
+    cur_ptr = __litl_write_fill_event_header(
+	trace, pos, trace->allow_delta_time ? 0 : p_buffer->last_time,
+	LITL_SAMPLING_CODE, LITL_TYPE_REGULAR);
+    cur_ptr->parameters.regular.nb_params = 5;
+    cur_ptr->parameters.regular.param[0] = trace->sampling_rules[i].code;
+    cur_ptr->parameters.regular.param[1] =
+      __atomic_load_n(&trace->sampling_rules[i].policy, __ATOMIC_RELAXED);
+    cur_ptr->parameters.regular.param[2] =
+      __atomic_load_n(&trace->sampling_rules[i].value, __ATOMIC_RELAXED);
+    cur_ptr->parameters.regular.param[3] = state->nb_events;
+    cur_ptr->parameters.regular.param[4] = state->nb_recorded_events;
+    pos += __litl_get_gen_event_size(cur_ptr)
+      - __litl_write_get_delta_shift(trace);
+
+    if (!is_dump)
+      state->nb_reported_events = state->nb_events;
+  }
+
+  return pos - start;
+}
+
+/*
+ * Records an event with offset only
+ */
+static void __litl_write_probe_offset(litl_write_trace_t* trace,
+				      litl_med_size_t index) {
+  // the offset event terminates the chunk, so it is recorded even when the
+  //   recording is paused
+  if (!trace->is_litl_initialized)
+    return;
+
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+
+  // the sampling counters are recorded when the chunk is closed
+  p_buffer->buffer += __litl_write_fill_sampling_counters(trace, p_buffer,
+							  p_buffer->buffer, 0);
+
+  litl_t* cur_ptr = __litl_write_fill_event_header(trace, p_buffer->buffer, 0,
+						   LITL_OFFSET_CODE,
+						   LITL_TYPE_REGULAR);
+  cur_ptr->parameters.offset.nb_params = 1;
+  cur_ptr->parameters.offset.offset = 0;
+
+  p_buffer->buffer += __litl_get_gen_event_size(cur_ptr)
+    - __litl_write_get_delta_shift(trace);
+}
+
+/* Open a trace file. If the file already exists, delete it first
+ */
+static int __litl_open_new_file(const char* filename) {
+  int f_handle;
+  // the trace file may be mapped, which needs the read access
+  /* if file exist. delete it first */
+  if ((f_handle = open(filename, O_RDWR | O_CREAT | O_EXCL, 0644))
+      < 0) {
+
+    if(errno == EEXIST) {
+      /* file already exist. Delete it and open it */
+      if(unlink(filename) < 0 ){
+	perror("Cannot delete trace file");
+	exit(EXIT_FAILURE);
+      }
+      if ((f_handle = open(filename, O_RDWR | O_CREAT | O_EXCL, 0644))
+	  < 0) {
+	perror("Cannot open trace file");
+	exit(EXIT_FAILURE);
+      }
+     } else {
+      fprintf(stderr, "Cannot open %s\n", filename);
+      exit(EXIT_FAILURE);
+    }
+  }
+  return f_handle;
+}
+
+/*
+ * Write the header on the disk
+ */
+static void __litl_write_update_header(litl_write_trace_t* trace) {
+  // write the trace header to the trace file
+  assert(trace->f_handle >= 0);
+
+  if (pwrite(trace->f_handle, trace->header_ptr,
+	     __litl_write_get_header_size(trace), 0) == -1) {
+    perror(
+	   "Flushing the buffer. Could not write measured data to the trace file!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Update the header and flush it to disk
+ */
+static void __litl_write_flush_header(litl_write_trace_t* trace) {
+
+  if (!trace->is_header_flushed) {
+    litl_med_size_t i, nb_threads, nb_header_threads;
+    litl_med_size_t* header_threads;
+    litl_write_buffer_t* p_buffer;
+
+    // open the trace file
+    trace->f_handle = __litl_open_new_file(trace->filename);
+
+    // the chunks are written through a second handle that bypasses the
+    //   page cache, the header and the offsets through the first one
+    if (trace->allow_direct_io && !trace->allow_per_thread_files) {
+      trace->f_direct_handle = open(trace->filename, O_WRONLY | O_DIRECT);
+      if (trace->f_direct_handle < 0)
+	fprintf(stderr,
+		"[LiTL] Warning: %s does not support direct I/O, the trace is written through the page cache\n",
+		trace->filename);
+      else
+	__atomic_store_n(&trace->is_direct_io, 1, __ATOMIC_RELAXED);
+    }
+
+    // only the threads that finished their registration are stored in the
+    //   header; the other ones are added to the next slots. Threads may
+    //   finish their registration meanwhile, so the list is built once
+    //   With the footer index, they are listed in the footer
+    nb_threads = __litl_write_has_footer_index(trace) ? 0 :
+      __atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE);
+    header_threads = malloc((nb_threads + 1) * sizeof(litl_med_size_t));
+    if (!header_threads) {
+      perror("Could not allocate memory for the trace header!");
+      exit(EXIT_FAILURE);
+    }
+    nb_header_threads = 0;
+    for (i = 0; i < nb_threads; i++)
+      if (__litl_write_get_registered_buffer(trace, i))
+	header_threads[nb_header_threads++] = i;
+    trace->nb_flushed_threads = nb_header_threads;
 
     // add a header to the trace file
     trace->header_size = sizeof(litl_general_header_t)
       + sizeof(litl_process_header_t)
-      + (trace->nb_threads + 1) * sizeof(litl_thread_pair_t);
+      + (nb_header_threads + 1) * sizeof(litl_thread_pair_t);
     __litl_write_add_trace_header(trace);
 
     // add information about each working thread: (tid, offset)
-    litl_med_size_t i;
-    for (i = 0; i < trace->nb_threads; i++) {
+    for (i = 0; i < nb_header_threads; i++) {
+      p_buffer = __litl_write_get_thread_buffer(trace, header_threads[i]);
+
       printf("trace->header: %p\n", trace->header);
-      ((litl_thread_pair_t *) trace->header)->tid = trace->buffers[i]->tid;
-      ((litl_thread_pair_t *) trace->header)->offset = 0;
+      ((litl_thread_pair_t *) trace->header)->tid = p_buffer->tid;
+      // with per-thread files, the events of the thread are stored in its
+      //   own file, right after its header
+      ((litl_thread_pair_t *) trace->header)->offset =
+	trace->allow_per_thread_files ? 2 * sizeof(litl_thread_pair_t) : 0;
 
       trace->header += sizeof(litl_thread_pair_t);
 
       // save the position of offset inside the trace file
-      trace->buffers[i]->offset = __litl_write_get_header_size(trace)
+      p_buffer->offset = __litl_write_get_header_size(trace)
 	- sizeof(litl_offset_t);
-      trace->buffers[i]->already_flushed = 1;
     }
 
     // offset indicates the position of offset to the next slot of
@@ -370,69 +1395,348 @@ static void __litl_write_flush_header(litl_write_trace_t* trace) {
     // write the trace header to the trace file
     __litl_write_update_header(trace);
 
-    trace->general_offset = __litl_write_get_header_size(trace);
+    trace->general_offset = __litl_write_get_aligned_size(
+	trace, __litl_write_get_header_size(trace));
+
+    // the owner threads check already_flushed without holding the lock and
+    //   then reserve their chunks, so general_offset must be set first
+    trace->header_nb_threads = nb_header_threads;
+    for (i = 0; i < nb_header_threads; i++)
+      __atomic_store_n(
+	  &__litl_write_get_thread_buffer(trace, header_threads[i])->already_flushed,
+	  1, __ATOMIC_RELEASE);
+    free(header_threads);
 
-    trace->header_nb_threads = trace->nb_threads;
     trace->threads_offset = 0;
     trace->nb_slots = 0;
 
-    trace->is_header_flushed = 1;
+    __atomic_store_n(&trace->is_header_flushed, 1, __ATOMIC_RELEASE);
   }
 }
 
 
 /*
- * Write the thread-specific header to disk
+ * Reserves a range of the trace file. Ranges are reserved atomically, so
+ *   threads can write their chunks in parallel
  */
-static void __litl_write_flush_thread_header(litl_write_trace_t* trace,
-					     litl_med_size_t index,
-					     litl_offset_t header_size) {
-  litl_offset_t offset;
-  int res;
-  // when more buffers to store threads information is required
-  if (trace->nb_threads
-      > (trace->header_nb_threads + NBTHREADS * trace->nb_slots)) {
+static litl_offset_t __litl_write_reserve_offset(litl_write_trace_t* trace,
+						 litl_size_t size) {
+  return __atomic_fetch_add(&trace->general_offset,
+			    __litl_write_get_aligned_size(trace, size),
+			    __ATOMIC_RELAXED);
+}
 
-    // updated the offset from the previous slot
-    lseek(trace->f_handle, trace->header_offset + sizeof(litl_tid_t),
-	  SEEK_SET);
-    offset = trace->general_offset - header_size;
-    res = write(trace->f_handle, &offset, sizeof(litl_offset_t));
-    assert(res>=0);
+/*
+ * Writes data at a given position of the trace file
+ */
+static void __litl_write_pwrite(litl_write_trace_t* trace, const void* data,
+				size_t size, litl_offset_t position) {
+  if (pwrite(trace->f_handle, data, size, position) == -1) {
+    perror(
+	"Flushing the buffer. Could not write measured data to the trace file!");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Writes a chunk of events at a given position of the trace file. With
+ *   direct I/O, the chunk is padded with zeros up to the alignment, which its
+ *   memory has room for. If the file system refuses the direct writes, the
+ *   trace is written through the page cache from then on
+ */
+static void __litl_write_pwrite_chunk(litl_write_trace_t* trace,
+				      litl_buffer_t buffer_ptr,
+				      litl_size_t size, litl_offset_t position) {
+  litl_size_t aligned_size;
+
+  if (__atomic_load_n(&trace->is_direct_io, __ATOMIC_RELAXED)) {
+    aligned_size = __litl_write_get_aligned_size(trace, size);
+    memset(buffer_ptr + size, 0, aligned_size - size);
+    if (pwrite(trace->f_direct_handle, buffer_ptr, aligned_size, position)
+	!= -1)
+      return;
+    if (errno != EINVAL) {
+      perror(
+	  "Flushing the buffer. Could not write measured data to the trace file!");
+      exit(EXIT_FAILURE);
+    }
+    if (__atomic_exchange_n(&trace->is_direct_io, 0, __ATOMIC_RELAXED))
+      fprintf(stderr,
+	      "[LiTL] Warning: %s does not support direct I/O, the trace is written through the page cache\n",
+	      trace->filename);
+  }
+
+  __litl_write_pwrite(trace, buffer_ptr, size, position);
+}
+
+#ifdef SYS_io_uring_setup
+/*
+ * The io_uring of a thread buffer: its submission and completion queues
+ *   mapped from the kernel
+ */
+struct litl_write_uring {
+  int fd;
+  unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void *sq_ring, *cq_ring;
+  size_t sq_ring_length, cq_ring_length, sqes_length;
+};
+
+/*
+ * Releases the io_uring of a thread buffer
+ */
+static void __litl_write_destroy_uring(struct litl_write_uring* uring) {
+  if (uring->sqes && uring->sqes != MAP_FAILED)
+    munmap(uring->sqes, uring->sqes_length);
+  if (uring->cq_ring && uring->cq_ring != MAP_FAILED
+      && uring->cq_ring != uring->sq_ring)
+    munmap(uring->cq_ring, uring->cq_ring_length);
+  if (uring->sq_ring && uring->sq_ring != MAP_FAILED)
+    munmap(uring->sq_ring, uring->sq_ring_length);
+  close(uring->fd);
+  free(uring);
+}
+
+/*
+ * Sets up the io_uring of a thread buffer. Returns NULL if the kernel does
+ *   not support io_uring or forbids it
+ */
+static struct litl_write_uring* __litl_write_setup_uring() {
+  struct io_uring_params params;
+  struct litl_write_uring* uring;
+
+  uring = calloc(1, sizeof(struct litl_write_uring));
+  if (!uring) {
+    perror("Could not allocate memory for the io_uring!");
+    exit(EXIT_FAILURE);
+  }
+  memset(&params, 0, sizeof(params));
+  uring->fd = syscall(SYS_io_uring_setup, LITL_URING_ENTRIES, &params);
+  if (uring->fd < 0) {
+    free(uring);
+    return NULL;
+  }
+
+  uring->sq_ring_length = params.sq_off.array
+    + params.sq_entries * sizeof(unsigned);
+  uring->cq_ring_length = params.cq_off.cqes
+    + params.cq_entries * sizeof(struct io_uring_cqe);
+  // recent kernels map both queues at once
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (uring->cq_ring_length > uring->sq_ring_length)
+      uring->sq_ring_length = uring->cq_ring_length;
+    uring->cq_ring_length = uring->sq_ring_length;
+  }
+  uring->sqes_length = params.sq_entries * sizeof(struct io_uring_sqe);
+
+  uring->sq_ring = mmap(NULL, uring->sq_ring_length, PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_POPULATE, uring->fd, IORING_OFF_SQ_RING);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    uring->cq_ring = uring->sq_ring;
+  else
+    uring->cq_ring = mmap(NULL, uring->cq_ring_length, PROT_READ|PROT_WRITE,
+			  MAP_SHARED|MAP_POPULATE, uring->fd,
+			  IORING_OFF_CQ_RING);
+  uring->sqes = mmap(NULL, uring->sqes_length, PROT_READ|PROT_WRITE,
+		     MAP_SHARED|MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+  if (uring->sq_ring == MAP_FAILED || uring->cq_ring == MAP_FAILED
+      || uring->sqes == MAP_FAILED) {
+    __litl_write_destroy_uring(uring);
+    return NULL;
+  }
+
+  uring->sq_head = uring->sq_ring + params.sq_off.head;
+  uring->sq_tail = uring->sq_ring + params.sq_off.tail;
+  uring->sq_mask = uring->sq_ring + params.sq_off.ring_mask;
+  uring->sq_array = uring->sq_ring + params.sq_off.array;
+  uring->cq_head = uring->cq_ring + params.cq_off.head;
+  uring->cq_tail = uring->cq_ring + params.cq_off.tail;
+  uring->cq_mask = uring->cq_ring + params.cq_off.ring_mask;
+  uring->cqes = uring->cq_ring + params.cq_off.cqes;
+  return uring;
+}
+#endif
+
+/*
+ * Stops using io_uring, which the kernel does not support
+ */
+static void __litl_write_disable_uring(litl_write_trace_t* trace) {
+  if (__atomic_exchange_n(&trace->is_io_uring, 0, __ATOMIC_RELAXED))
+    fprintf(stderr,
+	    "[LiTL] Warning: io_uring is not supported, the trace is written with pwrite\n");
+}
+
+/*
+ * Submits some writes to a file with a single system call and waits for
+ *   them. Stores the number of Bytes written by each of them, or leaves it
+ *   to 0 if io_uring does not support the write
+ */
+static void __litl_write_uring_write(litl_write_trace_t* trace,
+				     litl_write_buffer_t* p_buffer, int fd,
+				     litl_write_io_t* ios, int nb_ios,
+				     size_t* done) {
+#ifdef SYS_io_uring_setup
+  int i, nb_completed = 0;
+  unsigned head, tail, pos;
+  struct io_uring_sqe* sqe;
+  struct io_uring_cqe* cqe;
+  struct litl_write_uring* uring = p_buffer->uring;
+
+  assert(nb_ios <= LITL_URING_ENTRIES);
+  tail = *uring->sq_tail;
+  for (i = 0; i < nb_ios; i++) {
+    pos = tail & *uring->sq_mask;
+    sqe = &uring->sqes[pos];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t) ios[i].data;
+    sqe->len = ios[i].size;
+    sqe->off = ios[i].position;
+    sqe->user_data = i;
+    uring->sq_array[pos] = pos;
+    tail++;
+  }
+  __atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+
+  while (nb_completed < nb_ios) {
+    if (syscall(SYS_io_uring_enter, uring->fd,
+		tail - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE),
+		nb_ios - nb_completed, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+	&& errno != EINTR) {
+      // the remaining writes are done with pwrite
+      __litl_write_destroy_uring(uring);
+      p_buffer->uring = NULL;
+      __litl_write_disable_uring(trace);
+      return;
+    }
+
+    head = *uring->cq_head;
+    while (head != __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE)) {
+      cqe = &uring->cqes[head & *uring->cq_mask];
+      if (cqe->res >= 0) {
+	done[cqe->user_data] = cqe->res;
+      } else if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+	// the kernel is too old to write with io_uring
+	__litl_write_disable_uring(trace);
+      } else {
+	errno = -cqe->res;
+	perror(
+	    "Flushing the buffer. Could not write measured data to the trace file!");
+	exit(EXIT_FAILURE);
+      }
+      nb_completed++;
+      head++;
+    }
+    __atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+  }
+#else
+  (void) p_buffer;
+  (void) fd;
+  (void) ios;
+  (void) nb_ios;
+  (void) done;
+  __litl_write_disable_uring(trace);
+#endif
+}
+
+/*
+ * Writes some data at given positions of a file, e.g. a chunk and the offset
+ *   that links it. With io_uring, they are submitted with a single system
+ *   call. Otherwise, or for the data that io_uring did not write, with pwrite
+ */
+static void __litl_write_pwrite_ios(litl_write_trace_t* trace,
+				    litl_write_buffer_t* p_buffer, int fd,
+				    litl_write_io_t* ios, int nb_ios) {
+  int i;
+  ssize_t res;
+  size_t done[LITL_URING_ENTRIES];
+
+  memset(done, 0, sizeof(done));
+  if (__atomic_load_n(&trace->is_io_uring, __ATOMIC_RELAXED)) {
+#ifdef SYS_io_uring_setup
+    if (!p_buffer->uring)
+      p_buffer->uring = __litl_write_setup_uring();
+#endif
+    if (p_buffer->uring)
+      __litl_write_uring_write(trace, p_buffer, fd, ios, nb_ios, done);
+    else
+      __litl_write_disable_uring(trace);
+  }
+
+  for (i = 0; i < nb_ios; i++)
+    while (done[i] < ios[i].size) {
+      res = pwrite(fd, (const char*) ios[i].data + done[i],
+		   ios[i].size - done[i], ios[i].position + done[i]);
+      if (res == -1) {
+	perror(
+	    "Flushing the buffer. Could not write measured data to the trace file!");
+	exit(EXIT_FAILURE);
+      }
+      done[i] += res;
+    }
+}
+
+/*
+ * Releases the io_uring of a thread buffer, if any
+ */
+static void __litl_write_release_uring(litl_write_buffer_t* p_buffer) {
+#ifdef SYS_io_uring_setup
+  if (p_buffer->uring)
+    __litl_write_destroy_uring(p_buffer->uring);
+#endif
+  p_buffer->uring = NULL;
+}
+
+/*
+ * Write the thread-specific header to disk. Must be called with
+ *   lock_litl_flush held
+ */
+static void __litl_write_flush_thread_header(litl_write_trace_t* trace,
+					     litl_med_size_t index,
+					     litl_offset_t header_size,
+					     litl_offset_t chunk_offset) {
+  litl_offset_t offset;
+  litl_thread_pair_t thread_pairs[2];
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+  // when more buffers to store threads information is required
+  if (trace->nb_flushed_threads
+      >= (trace->header_nb_threads + NBTHREADS * trace->nb_slots)) {
 
     // reserve a new slot for pairs (tid, offset)
-    trace->header_offset = trace->general_offset;
+    litl_offset_t slot_offset = __litl_write_reserve_offset(
+	trace, (NBTHREADS + 1) * sizeof(litl_thread_pair_t));
+
+    // updated the offset from the previous slot
+    offset = slot_offset - header_size;
+    __litl_write_pwrite(trace, &offset, sizeof(litl_offset_t),
+			trace->header_offset + sizeof(litl_tid_t));
+
+    trace->header_offset = slot_offset;
     trace->threads_offset = trace->header_offset;
-    trace->general_offset += (NBTHREADS + 1) * sizeof(litl_thread_pair_t);
 
     trace->nb_slots++;
   }
 
-  // add a new pair (tid, offset)
-  lseek(trace->f_handle, trace->header_offset, SEEK_SET);
-  res = write(trace->f_handle, &trace->buffers[index]->tid,
-	      sizeof(litl_tid_t));
-  assert(res >= 0);
-  offset = trace->general_offset - header_size;
-  res = write(trace->f_handle, &offset, sizeof(litl_offset_t));
-  assert(res >= 0);
-
-  // add an indicator to specify the last slot of pairs (offset == 0)
-  // TODO: how to optimize this and write only once at the end of the slot
-  offset = 0;
-  res = write(trace->f_handle, &offset, sizeof(litl_tid_t));
-  assert(res >= 0);
-  res = write(trace->f_handle, &offset, sizeof(litl_offset_t));
-  assert(res >= 0);
+  // add a new pair (tid, offset) followed by an indicator to specify the
+  //   last slot of pairs (offset == 0)
+  thread_pairs[0].tid = p_buffer->tid;
+  thread_pairs[0].offset = chunk_offset - header_size;
+  thread_pairs[1].tid = 0;
+  thread_pairs[1].offset = 0;
+  __litl_write_pwrite(trace, thread_pairs, sizeof(thread_pairs),
+		      trace->header_offset);
 
   trace->header_offset += sizeof(litl_thread_pair_t);
-  trace->buffers[index]->already_flushed = 1;
+  __atomic_store_n(&p_buffer->already_flushed, 1, __ATOMIC_RELEASE);
 
   // updated the number of threads
   // TODO: perform update only once 'cause there is duplication
-  lseek(trace->f_handle, trace->header_size, SEEK_SET);
-  res = write(trace->f_handle, &trace->nb_threads, sizeof(litl_med_size_t));
-  assert(res >= 0);
+  trace->nb_flushed_threads++;
+  __litl_write_pwrite(trace, &trace->nb_flushed_threads,
+		      sizeof(litl_med_size_t), trace->header_size);
 }
 
 /*
@@ -440,166 +1744,1627 @@ static void __litl_write_flush_thread_header(litl_write_trace_t* trace,
  */
 static void __litl_write_update_thread_header(litl_write_trace_t* trace,
 					      litl_med_size_t index,
-					      litl_offset_t header_size) {
-    // update the previous offset of the current thread,
-    //   updating the location in the file
-    lseek(trace->f_handle, trace->buffers[index]->offset, SEEK_SET);
-    litl_offset_t offset = trace->general_offset - header_size;
-    int res = write(trace->f_handle, &offset, sizeof(litl_offset_t));
-    assert(res >= 0);
+					      litl_offset_t header_size,
+					      litl_offset_t chunk_offset) {
+  // update the previous offset of the current thread,
+  //   updating the location in the file
+  litl_offset_t offset = chunk_offset - header_size;
+  __litl_write_pwrite(trace, &offset, sizeof(litl_offset_t),
+		      __litl_write_get_thread_buffer(trace, index)->offset);
+}
+
+/*
+ * Returns the position in the trace file of the offset to the next chunk of
+ *   a thread, for a chunk of size Bytes written at chunk_offset
+ */
+static litl_offset_t __litl_write_get_next_offset_position(
+    litl_write_trace_t* trace, litl_offset_t chunk_offset, litl_size_t size) {
+  // in compressed traces, it is stored in the block header
+  if (trace->codec)
+    return chunk_offset + __litl_offset_of(litl_block_header_t, offset);
+  return chunk_offset + size - sizeof(litl_offset_t);
+}
+
+/*
+ * Compresses a chunk of events of a given thread into a block, which
+ *   replaces the chunk. Returns the size of the block
+ */
+static litl_size_t __litl_write_compress_chunk(litl_write_trace_t* trace,
+					       litl_med_size_t index,
+					       litl_buffer_t* buffer_ptr,
+					       litl_size_t size) {
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+  litl_block_header_t* block;
+  litl_size_t compressed_size;
+
+  if (!p_buffer->block_ptr) {
+    // with direct I/O, the blocks are written from aligned memory
+    if (trace->chunk_alignment) {
+      if (posix_memalign((void **) &p_buffer->block_ptr,
+			 trace->chunk_alignment,
+			 __litl_write_get_aligned_size(
+			     trace, sizeof(litl_block_header_t)
+			     + __litl_write_get_buffer_length(trace))))
+	p_buffer->block_ptr = NULL;
+    } else {
+      p_buffer->block_ptr = malloc(sizeof(litl_block_header_t)
+				   + __litl_write_get_buffer_length(trace));
+    }
+    if (!p_buffer->block_ptr) {
+      perror("Could not allocate memory for the compressed events!");
+      exit(EXIT_FAILURE);
+    }
+  }
+  block = (litl_block_header_t *) p_buffer->block_ptr;
+
+  // the chunks that do not compress are stored as they are
+  compressed_size = trace->codec->compress(
+      *buffer_ptr, size, p_buffer->block_ptr + sizeof(litl_block_header_t),
+      size - 1);
+  if (compressed_size > 0) {
+    block->codec = trace->codec->id;
+  } else {
+    memcpy(p_buffer->block_ptr + sizeof(litl_block_header_t), *buffer_ptr,
+	   size);
+    compressed_size = size;
+    block->codec = LITL_CODEC_NONE;
+  }
+  block->offset = 0;
+  block->size = size;
+  block->compressed_size = compressed_size;
+
+  *buffer_ptr = p_buffer->block_ptr;
+  return sizeof(litl_block_header_t) + compressed_size;
+}
+
+/*
+ * Writes a chunk of events of a given thread to its own trace file. The file
+ *   is a complete single-thread trace, so no lock is needed
+ */
+static void __litl_write_flush_thread_file(litl_write_trace_t* trace,
+					   litl_med_size_t index,
+					   litl_buffer_t buffer_ptr,
+					   litl_size_t size) {
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+  litl_offset_t header_size, offset;
+  litl_write_io_t ios[2];
+  int nb_ios = 0;
+
+  header_size = sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
+
+  if (p_buffer->f_handle < 0) {
+    // first flush of this thread: create its file and add a header with
+    //   one pair (tid, offset) followed by the last slot indicator
+    char* filename;
+    litl_size_t file_header_size = header_size
+      + 2 * sizeof(litl_thread_pair_t);
+
+    if (asprintf(&filename, "%s.%u", trace->filename, index) == -1) {
+      perror("Error: Cannot set the filename for recording events!\n");
+      exit(EXIT_FAILURE);
+    }
+    p_buffer->f_handle = __litl_open_new_file(filename);
+    free(filename);
+
+    litl_buffer_t header = calloc(1, file_header_size);
+    if (!header) {
+      perror("Could not allocate memory for the trace header!");
+      exit(EXIT_FAILURE);
+    }
+    __litl_write_fill_trace_header(
+	trace, header, 1,
+	__litl_write_get_process_flags(trace) & ~LITL_FLAG_PER_THREAD_FILES);
+    litl_thread_pair_t* thread_pair = (litl_thread_pair_t*) (header
+	+ header_size);
+    thread_pair->tid = p_buffer->tid;
+    thread_pair->offset = 2 * sizeof(litl_thread_pair_t);
+
+    if (pwrite(p_buffer->f_handle, header, file_header_size, 0) == -1) {
+      perror("Could not write the header to the trace file!");
+      exit(EXIT_FAILURE);
+    }
+    free(header);
+    p_buffer->general_offset = file_header_size;
+  } else {
+    // update the previous offset of the thread, together with the chunk
+    offset = p_buffer->general_offset - header_size;
+    ios[nb_ios].data = &offset;
+    ios[nb_ios].size = sizeof(litl_offset_t);
+    ios[nb_ios++].position = p_buffer->offset;
+  }
+
+  ios[nb_ios].data = buffer_ptr;
+  ios[nb_ios].size = size;
+  ios[nb_ios++].position = p_buffer->general_offset;
+  __litl_write_pwrite_ios(trace, p_buffer, p_buffer->f_handle, ios, nb_ios);
+
+  p_buffer->offset = __litl_write_get_next_offset_position(
+      trace, p_buffer->general_offset, size);
+  p_buffer->general_offset += size;
+}
+
+/*
+ * Writes the footer index after the chunks written so far and points the
+ *   only pair (tid, offset) of the header to it. The footers of the previous
+ *   checkpoints are left in the trace file. Must be called with lock_footer
+ *   held
+ */
+static void __litl_write_flush_footer(litl_write_trace_t* trace) {
+  litl_size_t i, footer_size;
+  litl_offset_t header_size, footer_offset;
+  litl_buffer_t footer, pos;
+  litl_footer_entry_t* entry;
+  litl_process_header_t* process_header;
+
+  trace->nb_unsaved_chunks = 0;
+  if (trace->nb_footer_threads == 0)
+    return;
+
+  footer_size = 0;
+  for (i = 0; i < trace->nb_footer_threads; i++)
+    footer_size += sizeof(litl_footer_thread_t)
+      + trace->footer_threads[i].nb_chunks * sizeof(litl_offset_t);
+  // with direct I/O, the footer is written like a chunk
+  if (trace->chunk_alignment) {
+    if (posix_memalign((void **) &footer, trace->chunk_alignment,
+		       __litl_write_get_aligned_size(trace, footer_size)))
+      footer = NULL;
+  } else {
+    footer = malloc(footer_size);
+  }
+  if (!footer) {
+    perror("Could not allocate memory for the footer index!");
+    exit(EXIT_FAILURE);
+  }
+
+  pos = footer;
+  for (i = 0; i < trace->nb_footer_threads; i++) {
+    entry = &trace->footer_threads[i];
+    ((litl_footer_thread_t *) pos)->tid = entry->tid;
+    ((litl_footer_thread_t *) pos)->nb_chunks = entry->nb_chunks;
+    pos += sizeof(litl_footer_thread_t);
+    memcpy(pos, entry->chunks, entry->nb_chunks * sizeof(litl_offset_t));
+    pos += entry->nb_chunks * sizeof(litl_offset_t);
+  }
+
+  footer_offset = __litl_write_reserve_offset(trace, footer_size);
+  __litl_write_pwrite_chunk(trace, footer, footer_size, footer_offset);
+  free(footer);
+
+  // the header is updated once the footer is written
+  header_size = sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
+  process_header = (litl_process_header_t *) (trace->header_ptr
+      + sizeof(litl_general_header_t));
+  process_header->nb_threads = trace->nb_footer_threads;
+  ((litl_thread_pair_t *) (trace->header_ptr + header_size))->offset =
+    footer_offset - header_size;
+  __litl_write_update_header(trace);
+}
+
+/*
+ * Flushes the header to disk unless another thread already did it
+ */
+static void __litl_write_ensure_header(litl_write_trace_t* trace) {
+  if (__atomic_load_n(&trace->is_header_flushed, __ATOMIC_ACQUIRE))
+    return;
+
+  if (trace->allow_thread_safety)
+    pthread_mutex_lock(&trace->lock_litl_flush);
+  if (!trace->is_header_flushed)
+    __litl_write_flush_header(trace);
+  if (trace->allow_thread_safety)
+    pthread_mutex_unlock(&trace->lock_litl_flush);
+}
+
+/*
+ * Lists a chunk of events of a given thread, written at chunk_offset, in the
+ *   footer index. The chunks are listed once they are written, so the
+ *   checkpoints only list complete chunks
+ */
+static void __litl_write_list_chunk(litl_write_trace_t* trace,
+				    litl_med_size_t index,
+				    litl_offset_t chunk_offset) {
+  litl_offset_t header_size;
+  litl_offset_t* chunks;
+  litl_footer_entry_t* entry;
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+
+  header_size = sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
+  pthread_mutex_lock(&trace->lock_footer);
+  if (!p_buffer->footer_thread) {
+    if (trace->nb_footer_threads == (litl_med_size_t) -1) {
+      fprintf(stderr, "[LiTL] Too many threads!\n");
+      exit(EXIT_FAILURE);
+    }
+    if (trace->nb_footer_threads % NBTHREADS == 0) {
+      entry = realloc(trace->footer_threads,
+		      (trace->nb_footer_threads + NBTHREADS)
+		      * sizeof(litl_footer_entry_t));
+      if (!entry) {
+	perror("Could not allocate memory for the footer index!");
+	exit(EXIT_FAILURE);
+      }
+      trace->footer_threads = entry;
+    }
+    entry = &trace->footer_threads[trace->nb_footer_threads++];
+    entry->tid = p_buffer->tid;
+    entry->chunks = NULL;
+    entry->nb_chunks = 0;
+    entry->max_chunks = 0;
+    p_buffer->footer_thread = trace->nb_footer_threads;
+  }
+
+  entry = &trace->footer_threads[p_buffer->footer_thread - 1];
+  if (entry->nb_chunks == entry->max_chunks) {
+    chunks = realloc(entry->chunks,
+		     (entry->max_chunks ? 2 * entry->max_chunks : NBTHREADS)
+		     * sizeof(litl_offset_t));
+    if (!chunks) {
+      perror("Could not allocate memory for the footer index!");
+      exit(EXIT_FAILURE);
+    }
+    entry->chunks = chunks;
+    entry->max_chunks = entry->max_chunks ? 2 * entry->max_chunks : NBTHREADS;
+  }
+  entry->chunks[entry->nb_chunks++] = chunk_offset - header_size;
+
+  trace->nb_unsaved_chunks++;
+  if (trace->footer_checkpoint
+      && trace->nb_unsaved_chunks >= trace->footer_checkpoint)
+    __litl_write_flush_footer(trace);
+  pthread_mutex_unlock(&trace->lock_footer);
+}
+
+/*
+ * Links a chunk of events of a given thread, stored at chunk_offset, to the
+ *   previous chunk of the thread, or adds a pair (tid, offset) for its first
+ *   chunk, then writes the chunk unless buffer_ptr is NULL. Only the pairs
+ *   (tid, offset) are added under lock_litl_flush
+ */
+static void __litl_write_link_chunk(litl_write_trace_t* trace,
+				    litl_med_size_t index,
+				    litl_offset_t chunk_offset,
+				    litl_buffer_t buffer_ptr,
+				    litl_size_t size) {
+  litl_offset_t header_size, offset;
+  litl_write_io_t ios[2];
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+
+  header_size = sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
+  if (!__atomic_load_n(&p_buffer->already_flushed, __ATOMIC_ACQUIRE)) {
+    // handle the situation when some threads start after the header was
+    //   flushed
+    if (trace->allow_thread_safety)
+      pthread_mutex_lock(&trace->lock_litl_flush);
+    __litl_write_flush_thread_header(trace, index, header_size, chunk_offset);
+    if (trace->allow_thread_safety)
+      pthread_mutex_unlock(&trace->lock_litl_flush);
+  } else if (buffer_ptr
+	     && !__atomic_load_n(&trace->is_direct_io, __ATOMIC_RELAXED)) {
+    // the offset in the previous chunk and the chunk are written together
+    offset = chunk_offset - header_size;
+    ios[0].data = &offset;
+    ios[0].size = sizeof(litl_offset_t);
+    ios[0].position = p_buffer->offset;
+    ios[1].data = buffer_ptr;
+    ios[1].size = size;
+    ios[1].position = chunk_offset;
+    __litl_write_pwrite_ios(trace, p_buffer, trace->f_handle, ios, 2);
+    buffer_ptr = NULL;
+  } else {
+    __litl_write_update_thread_header(trace, index, header_size,
+				      chunk_offset);
+  }
+
+  if (buffer_ptr)
+    __litl_write_pwrite_chunk(trace, buffer_ptr, size, chunk_offset);
+
+  // update the current offset of the thread
+  p_buffer->offset = __litl_write_get_next_offset_position(trace,
+							    chunk_offset, size);
+}
+
+/*
+ * Writes a chunk of events of a given thread to the trace file. The chunk
+ *   must already end with an offset event.
+ * Only the header and the pairs (tid, offset) are updated under
+ *   lock_litl_flush; the chunks of different threads are written in parallel.
+ *   With the footer index, the chunk is only appended to the trace file
+ */
+static void __litl_write_flush_data(litl_write_trace_t* trace,
+				    litl_med_size_t index,
+				    litl_buffer_t buffer_ptr,
+				    litl_size_t size) {
+  litl_offset_t chunk_offset;
+  if (!trace->is_litl_initialized)
+    return;
+
+  if (trace->codec)
+    size = __litl_write_compress_chunk(trace, index, &buffer_ptr, size);
+
+  if (trace->allow_per_thread_files) {
+    __litl_write_flush_thread_file(trace, index, buffer_ptr, size);
+    return;
+  }
+
+  __litl_write_ensure_header(trace);
+  chunk_offset = __litl_write_reserve_offset(trace, size);
+
+  if (trace->allow_footer_index) {
+    __litl_write_pwrite_chunk(trace, buffer_ptr, size, chunk_offset);
+    __litl_write_list_chunk(trace, index, chunk_offset);
+  } else {
+    __litl_write_link_chunk(trace, index, chunk_offset, buffer_ptr, size);
+  }
 }
 
 /*
- * Writes the recorded events from the buffer to the trace file
+ * Writes the recorded events from the buffer to the trace file. With the
+ *   mapped output, they already are in the trace file, so the chunk is only
+ *   linked or listed
  */
 static void __litl_write_flush_buffer(litl_write_trace_t* trace,
 				      litl_med_size_t index) {
-  int res __attribute__ ((__unused__));
-  litl_offset_t header_size;
+  litl_write_buffer_t* p_buffer;
   if (!trace->is_litl_initialized)
     return;
 
-  if (trace->allow_thread_safety)
-    pthread_mutex_lock(&trace->lock_litl_flush);
+  // add an event with offset
+  __litl_write_probe_offset(trace, index);
+  p_buffer = __litl_write_get_thread_buffer(trace, index);
+  if (p_buffer->mapped_window) {
+    if (trace->allow_footer_index)
+      __litl_write_list_chunk(trace, index, p_buffer->mapped_offset);
+    else
+      __litl_write_link_chunk(trace, index, p_buffer->mapped_offset, NULL,
+			      __litl_write_get_buffer_size(trace, index));
+  } else {
+    __litl_write_flush_data(trace, index, p_buffer->buffer_ptr,
+			    __litl_write_get_buffer_size(trace, index));
+  }
+
+  p_buffer->buffer = p_buffer->buffer_ptr;
+}
+
+/* use mmap instead of malloc so that we can use the MAP_POPULATE option
+   that makes sure the page table is populated. This way, the page faults
+   caused by litl are sensibly reduced.
+*/
+#define USE_MMAP
+
+/*
+ * Returns the size of the memory region backing a thread buffer: the buffer
+ *   itself, the tail of the last event, the sampling counters and the offset
+ *   event
+ */
+static size_t __litl_write_get_buffer_length(litl_write_trace_t* trace) {
+  return __litl_write_get_buffer_capacity(trace) + __litl_get_reg_event_size(LITL_MAX_PARAMS)
+    + LITL_MAX_SAMPLING_RULES * __litl_get_reg_event_size(5)
+    + __litl_get_reg_event_size(1);
+}
+
+/*
+ * Returns the size of a memory mapping that holds length Bytes. With huge
+ *   pages, it is a multiple of their size
+ */
+static size_t __litl_write_get_mapping_length(litl_write_trace_t* trace,
+					      size_t length) {
+  // with direct I/O, the chunks are padded in place
+  length = __litl_write_get_aligned_size(trace, length);
+  if (trace->hugepages != LITL_HUGEPAGES_NONE)
+    length = (length + trace->hugepage_size - 1) / trace->hugepage_size
+      * trace->hugepage_size;
+  return length;
+}
+
+/*
+ * Returns the NUMA node of the calling thread, or -1 if the buffers are not
+ *   bound to NUMA nodes
+ */
+static int __litl_write_get_numa_node(litl_write_trace_t* trace) {
+  unsigned cpu __attribute__ ((__unused__)), node;
+
+  // the chunks of the shared pool and the mappings of the trace file are not
+  //   bound
+  if (!trace->allow_numa || trace->chunk_size
+      || __litl_write_has_mapped_output(trace))
+    return -1;
+#ifdef SYS_getcpu
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0
+      && node < LITL_MAX_NUMA_NODES)
+    return node;
+#endif
+  return -1;
+}
+
+/*
+ * Binds the memory of a thread buffer to a NUMA node. The kernel falls back to
+ *   the other nodes when the node is full
+ */
+static void __litl_write_bind_buffer_memory(litl_buffer_t buffer_ptr,
+					    size_t length, int node) {
+#if defined(SYS_mbind) && defined(__linux__)
+  unsigned long nodemask[LITL_MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+
+  memset(nodemask, 0, sizeof(nodemask));
+  nodemask[node / (8 * sizeof(unsigned long))] = 1UL
+    << (node % (8 * sizeof(unsigned long)));
+  // if the memory cannot be bound, it is still allocated by the owner thread
+  //   in most cases, i.e. on its node
+  syscall(SYS_mbind, buffer_ptr, length, MPOL_PREFERRED, nodemask,
+	  LITL_MAX_NUMA_NODES + 1, 0);
+#else
+  (void) buffer_ptr;
+  (void) length;
+  (void) node;
+#endif
+}
+
+/*
+ * Allocates all the pages of a thread buffer
+ */
+static void __litl_write_populate_buffer_memory(litl_buffer_t buffer_ptr,
+						size_t length) {
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(buffer_ptr, length, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  memset(buffer_ptr, 0, length);
+}
+
+/*
+ * Checks whether the kernel provides transparent huge pages to the memory
+ *   areas that ask for them
+ */
+static int __litl_write_is_thp_enabled() {
+  char str[128];
+  int is_enabled = 0;
+  FILE* f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+
+  if (f) {
+    is_enabled = fgets(str, sizeof(str), f) && !strstr(str, "[never]");
+    fclose(f);
+  }
+  return is_enabled;
+}
+
+/*
+ * Records the kind of pages obtained for a buffer and warns when it is not
+ *   the requested one
+ */
+static void __litl_write_report_hugepages(litl_write_trace_t* trace,
+					  litl_hugepages_t hugepages) {
+  static const char* names[] = { "none", "thp", "hugetlb" };
+  litl_hugepages_t obtained = __atomic_load_n(&trace->hugepages_obtained,
+					      __ATOMIC_RELAXED);
+
+  do {
+    if (hugepages >= obtained)
+      return;
+  } while (!__atomic_compare_exchange_n(&trace->hugepages_obtained, &obtained,
+					hugepages, 1, __ATOMIC_RELAXED,
+					__ATOMIC_RELAXED));
+
+  fprintf(stderr,
+	  "[LiTL] Warning: cannot back the buffers with '%s' pages, using '%s' pages instead\n",
+	  names[obtained], names[hugepages]);
+}
+
+/*
+ * Maps the memory for thread buffers, on a given NUMA node or, if node is -1,
+ *   on the node of the calling thread
+ */
+static litl_buffer_t __litl_write_map_memory(litl_write_trace_t* trace,
+					     size_t length, int node) {
+  litl_buffer_t buffer_ptr;
+
+#ifdef USE_MMAP
+  int mmap_flags = MAP_SHARED|MAP_ANONYMOUS;
+  litl_hugepages_t hugepages = trace->hugepages;
+
+  buffer_ptr = MAP_FAILED;
+  if (hugepages != LITL_HUGEPAGES_NONE) {
+    // huge pages back private memory. Explicit huge pages have to be
+    //   reserved by the administrator, otherwise fall back to transparent ones
+    mmap_flags = MAP_PRIVATE|MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+    if (hugepages == LITL_HUGEPAGES_HUGETLB)
+      buffer_ptr = mmap(NULL, length, PROT_READ|PROT_WRITE,
+			mmap_flags|MAP_HUGETLB, -1, 0);
+#endif
+    if (buffer_ptr == MAP_FAILED)
+      hugepages = LITL_HUGEPAGES_THP;
+  }
+#ifdef MAP_POPULATE
+  /* make sure the pages are in the page table. This should reduce page faults when recording events  */
+  // the pages of bound buffers and of huge pages are populated afterwards
+  else if (node < 0)
+    mmap_flags |= MAP_POPULATE;
+#endif
+
+  if (buffer_ptr == MAP_FAILED)
+    buffer_ptr = mmap(NULL,
+		      length,
+		      PROT_READ|PROT_WRITE,
+		      mmap_flags,
+		      -1,
+		      0);
+  if(buffer_ptr == MAP_FAILED) {
+    perror("mmap");
+    buffer_ptr = NULL;
+  } else if (node >= 0 || trace->hugepages != LITL_HUGEPAGES_NONE) {
+    if (hugepages == LITL_HUGEPAGES_THP) {
+#ifdef MADV_HUGEPAGE
+      if (!__litl_write_is_thp_enabled()
+	  || madvise(buffer_ptr, length, MADV_HUGEPAGE) != 0)
+#endif
+	hugepages = LITL_HUGEPAGES_NONE;
+    }
+    if (trace->hugepages != LITL_HUGEPAGES_NONE)
+      __litl_write_report_hugepages(trace, hugepages);
+
+    if (node >= 0)
+      __litl_write_bind_buffer_memory(buffer_ptr, length, node);
+    __litl_write_populate_buffer_memory(buffer_ptr, length);
+  } else {
+#ifdef MAP_POPULATE
+    /* touch the first pages */
+    if(length> 1024*1024)
+      length=1024*1024;
+#endif	/* if MAP_POPULATE is not available, touch the whole buffer to avoid future page faults */
+    memset(buffer_ptr, 0, length);
+  }
+
+#else  /* USE_MMAP */
+  // malloc'ed buffers cannot be bound, they are allocated by first touch
+  (void) node;
+  buffer_ptr = malloc(length);
+#endif	/* USE_MMAP */
+
+  if (!buffer_ptr) {
+    perror("Could not allocate memory buffer for the thread\n!");
+    exit(EXIT_FAILURE);
+  }
+
+  // touch the memory so that it is allocated for real (otherwise, this may
+  //    cause performance issues on NUMA machines)
+  memset(buffer_ptr, 1, 1);
+  return buffer_ptr;
+}
+
+/*
+ * Releases the memory mapped by __litl_write_map_memory
+ */
+static void __litl_write_unmap_memory(litl_write_trace_t* trace
+				      __attribute__ ((__unused__)),
+				      litl_buffer_t buffer_ptr,
+				      size_t length __attribute__ ((__unused__))) {
+#ifdef USE_MMAP
+  int ret __attribute__ ((__unused__));
+  ret = munmap(buffer_ptr, length);
+  assert(ret==0);
+#else
+  free(buffer_ptr);
+#endif
+}
+
+/*
+ * Returns the distance between two chunks of the shared pool: the chunk and
+ *   its tail, aligned on a cache line so that the threads do not share any
+ */
+static size_t __litl_write_get_chunk_length(litl_write_trace_t* trace) {
+  // with direct I/O, the chunks are aligned and padded in place
+  if (trace->chunk_alignment)
+    return __litl_write_get_aligned_size(trace,
+					 __litl_write_get_buffer_length(trace));
+  return (__litl_write_get_buffer_length(trace) + LITL_CACHE_LINE_SIZE - 1)
+    / LITL_CACHE_LINE_SIZE * LITL_CACHE_LINE_SIZE;
+}
+
+/*
+ * Takes a chunk from the shared pool. When the pool is empty, it is refilled
+ *   with a new slab of chunks
+ */
+static litl_buffer_t __litl_write_get_chunk(litl_write_trace_t* trace) {
+  litl_buffer_t chunk, slab, *slabs;
+  size_t i, chunk_length, slab_length;
+
+  pthread_mutex_lock(&trace->lock_chunk_pool);
+  if (!trace->chunk_pool) {
+    chunk_length = __litl_write_get_chunk_length(trace);
+    slab_length = __litl_write_get_mapping_length(
+	trace, LITL_CHUNKS_PER_SLAB * chunk_length);
+    slabs = realloc(trace->chunk_slabs,
+		    (trace->nb_chunk_slabs + 1) * sizeof(litl_buffer_t));
+    if (!slabs) {
+      perror("Could not allocate memory for the chunk pool!");
+      exit(EXIT_FAILURE);
+    }
+    trace->chunk_slabs = slabs;
+
+    // the slab is populated by the thread that needs a chunk
+    slab = __litl_write_map_memory(trace, slab_length, -1);
+    trace->chunk_slabs[trace->nb_chunk_slabs++] = slab;
+    for (i = slab_length / chunk_length; i > 0; i--) {
+      chunk = slab + (i - 1) * chunk_length;
+      *(litl_buffer_t*) chunk = trace->chunk_pool;
+      trace->chunk_pool = chunk;
+    }
+  }
+
+  // the free chunks are linked through their first Bytes
+  chunk = trace->chunk_pool;
+  trace->chunk_pool = *(litl_buffer_t*) chunk;
+  pthread_mutex_unlock(&trace->lock_chunk_pool);
+
+  return chunk;
+}
+
+/*
+ * Gives a chunk back to the shared pool
+ */
+static void __litl_write_put_chunk(litl_write_trace_t* trace,
+				   litl_buffer_t chunk) {
+  pthread_mutex_lock(&trace->lock_chunk_pool);
+  *(litl_buffer_t*) chunk = trace->chunk_pool;
+  trace->chunk_pool = chunk;
+  pthread_mutex_unlock(&trace->lock_chunk_pool);
+}
+
+/*
+ * Allocates the memory for one thread buffer, on a given NUMA node or, if
+ *   node is -1, on the node of the calling thread. With the chunk pool, the
+ *   buffer is a chunk
+ */
+static litl_buffer_t __litl_write_alloc_buffer_memory(litl_write_trace_t* trace,
+						      int node) {
+  if (trace->chunk_size)
+    return __litl_write_get_chunk(trace);
+  return __litl_write_map_memory(
+      trace,
+      __litl_write_get_mapping_length(trace,
+				      __litl_write_get_buffer_length(trace)),
+      node);
+}
+
+/*
+ * Releases the memory of one thread buffer
+ */
+static void __litl_write_free_buffer_memory(litl_write_trace_t* trace,
+					    litl_buffer_t buffer_ptr) {
+  if (trace->chunk_size)
+    __litl_write_put_chunk(trace, buffer_ptr);
+  else
+    __litl_write_unmap_memory(
+	trace,
+	buffer_ptr,
+	__litl_write_get_mapping_length(trace,
+					__litl_write_get_buffer_length(trace)));
+}
+
+/*
+ * Returns the distance between two chunks of a mapping of the trace file
+ */
+static size_t __litl_write_get_mapped_chunk_length(litl_write_trace_t* trace) {
+  return __litl_write_get_aligned_size(trace,
+				       __litl_write_get_buffer_length(trace));
+}
+
+/*
+ * Maps the next region of the trace file for the chunks of a thread. The
+ *   region is reserved like a chunk and allocated before it is mapped, so
+ *   the file grows without being shrunk and without touching the regions of
+ *   the other threads
+ */
+static void __litl_write_map_window(litl_write_trace_t* trace,
+				    litl_write_buffer_t* p_buffer) {
+  int ret;
+  size_t length = LITL_CHUNKS_PER_WINDOW
+    * __litl_write_get_mapped_chunk_length(trace);
+
+  __litl_write_ensure_header(trace);
+  p_buffer->mapped_offset = __litl_write_reserve_offset(trace, length);
+  ret = posix_fallocate(trace->f_handle, p_buffer->mapped_offset, length);
+  if (ret != 0) {
+    errno = ret;
+    perror("Could not extend the trace file!");
+    exit(EXIT_FAILURE);
+  }
+
+  p_buffer->mapped_window = mmap(NULL, length, PROT_READ|PROT_WRITE,
+#ifdef MAP_POPULATE
+				 MAP_SHARED|MAP_POPULATE,
+#else
+				 MAP_SHARED,
+#endif
+				 trace->f_handle, p_buffer->mapped_offset);
+  if (p_buffer->mapped_window == MAP_FAILED) {
+    perror("Could not map the trace file!");
+    exit(EXIT_FAILURE);
+  }
+  p_buffer->mapped_chunk = 0;
+  p_buffer->buffer_ptr = p_buffer->mapped_window;
+  p_buffer->buffer = p_buffer->buffer_ptr;
+}
+
+/*
+ * Releases the mapping of the trace file of a thread. The chunks are written
+ *   back by the kernel like any other page of the page cache
+ */
+static void __litl_write_unmap_window(litl_write_trace_t* trace,
+				      litl_write_buffer_t* p_buffer) {
+  munmap(p_buffer->mapped_window,
+	 LITL_CHUNKS_PER_WINDOW * __litl_write_get_mapped_chunk_length(trace));
+  p_buffer->mapped_window = NULL;
+  p_buffer->buffer_ptr = NULL;
+  p_buffer->buffer = NULL;
+}
+
+/*
+ * Moves the buffer of a thread to its next chunk of the trace file once the
+ *   current one is flushed, mapping the next region when the mapped one is
+ *   full
+ */
+static void __litl_write_next_mapped_chunk(litl_write_trace_t* trace,
+					   litl_write_buffer_t* p_buffer) {
+  size_t chunk_length = __litl_write_get_mapped_chunk_length(trace);
+
+  if (p_buffer->mapped_chunk + 1 == LITL_CHUNKS_PER_WINDOW) {
+    __litl_write_unmap_window(trace, p_buffer);
+    __litl_write_map_window(trace, p_buffer);
+    return;
+  }
+  p_buffer->mapped_chunk++;
+  p_buffer->mapped_offset += chunk_length;
+  p_buffer->buffer_ptr += chunk_length;
+  p_buffer->buffer = p_buffer->buffer_ptr;
+}
+
+/*
+ * Fills the pools of the online NUMA nodes with their first buffers. The
+ *   caller holds lock_numa_pools
+ */
+static void __litl_write_fill_numa_pools(litl_write_trace_t* trace) {
+  char str[256], *cur, *end;
+  long first, last, node;
+  litl_numa_pool_t* pool;
+  FILE* f;
+
+  trace->is_numa_pool_filled = 1;
+
+  // the online nodes are listed as "0-3,8"
+  f = fopen("/sys/devices/system/node/online", "r");
+  if (!f)
+    return;
+  cur = fgets(str, sizeof(str), f);
+  fclose(f);
+
+  while (cur && *cur && *cur != '\n') {
+    first = strtol(cur, &end, 10);
+    last = first;
+    if (*end == '-')
+      last = strtol(end + 1, &end, 10);
+    if (end == cur)
+      break;
+    for (node = first; node <= last && node < LITL_MAX_NUMA_NODES; node++) {
+      pool = &trace->numa_pools[node];
+      pool->buffers = malloc(trace->numa_pool_size * sizeof(litl_buffer_t));
+      if (!pool->buffers) {
+	perror("Could not allocate memory for the NUMA pools!");
+	exit(EXIT_FAILURE);
+      }
+      while (pool->nb_buffers < trace->numa_pool_size)
+	pool->buffers[pool->nb_buffers++] = __litl_write_alloc_buffer_memory(
+	    trace, node);
+    }
+    cur = *end == ',' ? end + 1 : end;
+  }
+}
+
+/*
+ * Returns 1 if the buffers are taken from the preallocated ones. They are
+ *   only used while the buffers keep the size they were preallocated with
+ */
+static int __litl_write_has_prealloc_buffers(litl_write_trace_t* trace) {
+  return trace->prealloc_size > 0 && !trace->chunk_size
+    && trace->prealloc_length == __litl_write_get_mapping_length(
+	trace, __litl_write_get_buffer_length(trace));
+}
+
+/*
+ * Allocates and populates the buffers of some threads before they register
+ */
+void litl_write_prealloc_threads(litl_write_trace_t* trace,
+				 litl_med_size_t nb_threads) {
+  size_t nb_buffers;
+  litl_buffer_t* buffers;
+
+  // the chunks of the shared pool, the mappings of the trace file and the
+  //   buffers bound to NUMA nodes are allocated by the threads
+  if (trace->chunk_size || __litl_write_has_mapped_output(trace)
+      || trace->allow_numa || nb_threads == 0)
+    return;
+  nb_buffers = (size_t) nb_threads
+    * (trace->allow_async_flush ? trace->nb_buffers : 1);
+
+  pthread_mutex_lock(&trace->lock_numa_pools);
+  if (trace->prealloc_size > 0 && !__litl_write_has_prealloc_buffers(trace)) {
+    fprintf(stderr, "[LiTL] Warning: cannot preallocate buffers of a different size\n");
+    pthread_mutex_unlock(&trace->lock_numa_pools);
+    return;
+  }
+  buffers = realloc(trace->prealloc_buffers,
+		    (trace->prealloc_size + nb_buffers) * sizeof(litl_buffer_t));
+  if (!buffers) {
+    perror("Could not allocate memory for the preallocated buffers!");
+    exit(EXIT_FAILURE);
+  }
+  trace->prealloc_buffers = buffers;
+  trace->prealloc_size += nb_buffers;
+  trace->prealloc_length = __litl_write_get_mapping_length(
+      trace, __litl_write_get_buffer_length(trace));
+  while (trace->nb_prealloc_buffers < trace->prealloc_size)
+    trace->prealloc_buffers[trace->nb_prealloc_buffers++] =
+      __litl_write_alloc_buffer_memory(trace, -1);
+  pthread_mutex_unlock(&trace->lock_numa_pools);
+}
+
+/*
+ * Returns a buffer of a NUMA node: from the pool of the node, or a new one.
+ *   If node is -1, the buffer is allocated on the node of the calling thread
+ */
+static litl_buffer_t __litl_write_get_numa_buffer(litl_write_trace_t* trace,
+						  int node) {
+  litl_buffer_t buffer_ptr = NULL;
+  litl_numa_pool_t* pool;
+
+  if (node >= 0 && trace->numa_pool_size > 0) {
+    pthread_mutex_lock(&trace->lock_numa_pools);
+    if (!trace->is_numa_pool_filled)
+      __litl_write_fill_numa_pools(trace);
+    pool = &trace->numa_pools[node];
+    if (pool->nb_buffers > 0)
+      buffer_ptr = pool->buffers[--pool->nb_buffers];
+    pthread_mutex_unlock(&trace->lock_numa_pools);
+  }
+
+  // the preallocated buffers are not bound
+  if (node < 0 && __litl_write_has_prealloc_buffers(trace)) {
+    pthread_mutex_lock(&trace->lock_numa_pools);
+    if (trace->nb_prealloc_buffers > 0)
+      buffer_ptr = trace->prealloc_buffers[--trace->nb_prealloc_buffers];
+    pthread_mutex_unlock(&trace->lock_numa_pools);
+  }
+
+  if (!buffer_ptr)
+    buffer_ptr = __litl_write_alloc_buffer_memory(trace, node);
+  return buffer_ptr;
+}
+
+/*
+ * Gives a buffer back to the pool of its NUMA node, or releases it if the
+ *   pool is full
+ */
+static void __litl_write_put_numa_buffer(litl_write_trace_t* trace, int node,
+					 litl_buffer_t buffer_ptr) {
+  litl_numa_pool_t* pool;
+
+  if (node >= 0 && trace->numa_pool_size > 0) {
+    pthread_mutex_lock(&trace->lock_numa_pools);
+    pool = &trace->numa_pools[node];
+    if (!pool->buffers)
+      pool->buffers = malloc(trace->numa_pool_size * sizeof(litl_buffer_t));
+    if (pool->buffers && pool->nb_buffers < trace->numa_pool_size) {
+      pool->buffers[pool->nb_buffers++] = buffer_ptr;
+      buffer_ptr = NULL;
+    }
+    pthread_mutex_unlock(&trace->lock_numa_pools);
+  }
+
+  if (node < 0 && __litl_write_has_prealloc_buffers(trace)) {
+    pthread_mutex_lock(&trace->lock_numa_pools);
+    if (trace->nb_prealloc_buffers < trace->prealloc_size) {
+      trace->prealloc_buffers[trace->nb_prealloc_buffers++] = buffer_ptr;
+      buffer_ptr = NULL;
+    }
+    pthread_mutex_unlock(&trace->lock_numa_pools);
+  }
+
+  if (buffer_ptr)
+    __litl_write_free_buffer_memory(trace, buffer_ptr);
+}
+
+/*
+ * When the calling thread has moved to another NUMA node, replaces its empty
+ *   current buffer and its spare buffers with buffers of the new node. The
+ *   buffers being written are replaced by the background flusher, so the
+ *   caller holds lock_flush_queue when it is used
+ */
+static void __litl_write_numa_migrate(litl_write_trace_t* trace,
+				      litl_write_buffer_t* p_buffer) {
+  litl_med_size_t i;
+  int node = __litl_write_get_numa_node(trace);
+
+  if (node < 0 || node == p_buffer->numa_node)
+    return;
+
+  __litl_write_put_numa_buffer(trace, p_buffer->numa_node,
+			       p_buffer->buffer_ptr);
+  p_buffer->buffer_ptr = __litl_write_get_numa_buffer(trace, node);
+  p_buffer->buffer = p_buffer->buffer_ptr;
+
+  for (i = 0; i < p_buffer->nb_spare_buffers; i++) {
+    __litl_write_put_numa_buffer(trace, p_buffer->numa_node,
+				 p_buffer->spare_buffers[i]);
+    p_buffer->spare_buffers[i] = __litl_write_get_numa_buffer(trace, node);
+  }
+  p_buffer->numa_node = node;
+}
+
+/*
+ * Checks whether the trace buffer was allocated. If no, then allocate
+ *    the buffer and, for otherwise too, returns the position of
+ *    the thread buffer in the array buffer_ptr/buffer.
+ */
+static void __litl_write_allocate_buffer(litl_write_trace_t* trace) {
+  litl_write_thread_key_t* key;
+  litl_med_size_t segment, segment_pos, nb_threads;
+  litl_write_buffer_t* p_buffer;
+
+  key = malloc(sizeof(litl_write_thread_key_t));
+  if (!key) {
+    perror("Could not allocate memory for the thread!");
+    exit(EXIT_FAILURE);
+  }
+  key->trace = trace;
+
+  // reuse the slot of a thread that exited, if any
+  nb_threads = (litl_med_size_t) -1;
+  if (__atomic_load_n(&trace->nb_free_slots, __ATOMIC_RELAXED) > 0) {
+    pthread_mutex_lock(&trace->lock_free_slots);
+    if (trace->nb_free_slots > 0)
+      nb_threads = trace->free_slots[--trace->nb_free_slots];
+    pthread_mutex_unlock(&trace->lock_free_slots);
+  }
+
+  if (nb_threads == (litl_med_size_t) -1) {
+    // reserve a slot in the buffer table; the published segments never
+    //   move, so no lock is needed. The number of threads must not wrap
+    //   around
+    nb_threads = __atomic_load_n(&trace->nb_threads, __ATOMIC_RELAXED);
+    do {
+      if (nb_threads == (litl_med_size_t) -1) {
+	fprintf(stderr, "[LiTL] Too many threads!\n");
+	exit(EXIT_FAILURE);
+      }
+    } while (!__atomic_compare_exchange_n(&trace->nb_threads, &nb_threads,
+					  nb_threads + 1, 1, __ATOMIC_RELAXED,
+					  __ATOMIC_RELAXED));
+  }
+  key->index = nb_threads;
+
+  __litl_write_locate_buffer(key->index, &segment, &segment_pos);
+  __litl_write_alloc_buffer_segment(trace, segment);
+  p_buffer = __litl_write_get_thread_buffer(trace, key->index);
+
+  p_buffer->tid = CUR_TID;
+  p_buffer->already_flushed = 0;
+  p_buffer->numa_node = __litl_write_get_numa_node(trace);
+  if (__litl_write_has_mapped_output(trace)) {
+    __litl_write_map_window(trace, p_buffer);
+  } else {
+    p_buffer->buffer_ptr = __litl_write_get_numa_buffer(trace,
+							p_buffer->numa_node);
+    p_buffer->buffer = p_buffer->buffer_ptr;
+  }
+  p_buffer->capacity = __litl_write_get_buffer_capacity(trace);
+
+  // the thread becomes visible to the flushing threads only once its
+  //   buffer is ready
+  __atomic_store_n(&p_buffer->initialized, 1, __ATOMIC_RELEASE);
+  pthread_setspecific(trace->index, key);
+}
+
+/*
+ * The destructor of the private thread variable: when a thread exits, its
+ *   buffer is flushed, its memory goes back to the pools and its slot is
+ *   reused by the next thread. The events of the flight recorder and of
+ *   traces without buffer flush stay in memory until the trace is
+ *   finalized, and the per-thread files are named after the slots, so the
+ *   buffers of these threads are kept
+ */
+static void __litl_write_release_thread(void* arg) {
+  litl_write_thread_key_t* key = (litl_write_thread_key_t*) arg;
+  litl_write_trace_t* trace = key->trace;
+  litl_med_size_t index = key->index;
+  litl_med_size_t* free_slots;
+  litl_write_buffer_t* p_buffer;
+
+  free(key);
+  if (!trace->is_litl_initialized || !trace->allow_buffer_flush
+      || trace->allow_ring_buffer || trace->allow_per_thread_files)
+    return;
+  p_buffer = __litl_write_get_registered_buffer(trace, index);
+  if (!p_buffer || p_buffer->nb_full_chunks > 0)
+    return;
+
+  // the events recorded later by this thread, e.g. by the destructors of
+  //   other private variables, get a new buffer instead of the recycled one
+  __litl_write_thread_cache.trace = NULL;
+  __litl_write_thread_cache.buffer = NULL;
+
+  // the chunks of the thread are written in order, so the last one waits
+  //   for the background flusher
+  pthread_mutex_lock(&trace->lock_flush_queue);
+  while (p_buffer->nb_pending_buffers > 0)
+    pthread_cond_wait(&trace->flush_done_cond, &trace->lock_flush_queue);
+  pthread_mutex_unlock(&trace->lock_flush_queue);
+  __litl_write_flush_buffer(trace, index);
+
+  __atomic_store_n(&p_buffer->initialized, 0, __ATOMIC_RELEASE);
+  if (p_buffer->mapped_window)
+    __litl_write_unmap_window(trace, p_buffer);
+  else
+    __litl_write_put_numa_buffer(trace, p_buffer->numa_node,
+				 p_buffer->buffer_ptr);
+  while (p_buffer->nb_spare_buffers > 0)
+    __litl_write_put_numa_buffer(
+	trace, p_buffer->numa_node,
+	p_buffer->spare_buffers[--p_buffer->nb_spare_buffers]);
+  free(p_buffer->spare_buffers);
+  free(p_buffer->block_ptr);
+  free(p_buffer->sampling);
+  free(p_buffer->staging);
+  __litl_write_release_uring(p_buffer);
+  memset(p_buffer, 0, sizeof(litl_write_buffer_t));
+  p_buffer->f_handle = -1;
+
+  pthread_mutex_lock(&trace->lock_free_slots);
+  if (trace->nb_free_slots % LITL_BUFFER_SEGMENT_SIZE == 0) {
+    free_slots = realloc(trace->free_slots,
+			 (trace->nb_free_slots + LITL_BUFFER_SEGMENT_SIZE)
+			 * sizeof(litl_med_size_t));
+    if (!free_slots) {
+      perror("Could not allocate memory for the free slots!");
+      exit(EXIT_FAILURE);
+    }
+    trace->free_slots = free_slots;
+  }
+  trace->free_slots[trace->nb_free_slots] = index;
+  __atomic_store_n(&trace->nb_free_slots, trace->nb_free_slots + 1,
+		   __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&trace->lock_free_slots);
+}
+
+/*
+ * The background flusher: writes the full buffers from the flush queue to the
+ *   trace file and gives them back to their threads
+ */
+static void* __litl_write_flush_thread(void* arg) {
+  litl_write_trace_t* trace = (litl_write_trace_t*) arg;
+  litl_flush_request_t request;
+
+  pthread_mutex_lock(&trace->lock_flush_queue);
+  while (1) {
+    while (trace->flush_queue_count == 0 && !trace->is_flush_thread_stopping)
+      pthread_cond_wait(&trace->flush_queue_cond, &trace->lock_flush_queue);
+
+    if (trace->flush_queue_count == 0)
+      // stopping and nothing left to write
+      break;
+
+    request = trace->flush_queue[trace->flush_queue_head];
+    trace->flush_queue_head = (trace->flush_queue_head + 1)
+      % trace->flush_queue_depth;
+    trace->flush_queue_count--;
+    pthread_mutex_unlock(&trace->lock_flush_queue);
+
+    // the requests of a thread are written in order, so its chain of chunks
+    //   stays consistent
+    __litl_write_flush_data(trace, request.index, request.buffer_ptr,
+			    request.size);
+
+    pthread_mutex_lock(&trace->lock_flush_queue);
+    litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(
+	trace, request.index);
+    p_buffer->nb_pending_buffers--;
+    if (trace->chunk_size) {
+      // the chunks go back to the shared pool
+      __litl_write_free_buffer_memory(trace, request.buffer_ptr);
+    } else {
+      if (request.numa_node != p_buffer->numa_node) {
+	// the thread moved to another NUMA node in the meantime
+	__litl_write_put_numa_buffer(trace, request.numa_node,
+				     request.buffer_ptr);
+	request.buffer_ptr = __litl_write_get_numa_buffer(trace,
+							  p_buffer->numa_node);
+      }
+      p_buffer->spare_buffers[p_buffer->nb_spare_buffers++] =
+	request.buffer_ptr;
+    }
+    pthread_cond_broadcast(&trace->flush_done_cond);
+  }
+  pthread_mutex_unlock(&trace->lock_flush_queue);
+
+  return NULL;
+}
+
+/*
+ * Allocates the spare buffers of a thread for the background flusher, unless
+ *   it already has them. Only the owner thread touches spare_buffers before
+ *   they are published
+ */
+static void __litl_write_alloc_spare_buffers(litl_write_trace_t* trace,
+					     litl_write_buffer_t* p_buffer) {
+  litl_med_size_t i, nb_spare_buffers = trace->nb_buffers - 1;
+  litl_buffer_t* spare_buffers;
+
+  if (p_buffer->spare_buffers || trace->chunk_size)
+    return;
+
+  spare_buffers = malloc(nb_spare_buffers * sizeof(litl_buffer_t));
+  if (!spare_buffers) {
+    perror("Could not allocate memory for the spare buffers!");
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < nb_spare_buffers; i++)
+    spare_buffers[i] = __litl_write_get_numa_buffer(trace,
+						    p_buffer->numa_node);
+
+  pthread_mutex_lock(&trace->lock_flush_queue);
+  p_buffer->spare_buffers = spare_buffers;
+  p_buffer->nb_spare_buffers = nb_spare_buffers;
+  pthread_mutex_unlock(&trace->lock_flush_queue);
+}
+
+/*
+ * Hands the full buffer of a thread over to the background flusher and
+ *   replaces it with a spare one. Returns -1 if the event has to be dropped
+ */
+static int __litl_write_submit_buffer(litl_write_trace_t* trace,
+				      litl_med_size_t index) {
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+
+  // first flush of this thread, unless it registered
+  __litl_write_alloc_spare_buffers(trace, p_buffer);
+
+  pthread_mutex_lock(&trace->lock_flush_queue);
+
+  if (!trace->is_flush_thread_running) {
+    trace->flush_queue = malloc(
+	trace->flush_queue_depth * sizeof(litl_flush_request_t));
+    if (!trace->flush_queue) {
+      perror("Could not allocate memory for the flush queue!");
+      exit(EXIT_FAILURE);
+    }
+    if (pthread_create(&trace->flush_thread, NULL, __litl_write_flush_thread,
+		       trace) != 0) {
+      perror("Could not start the background flusher!");
+      exit(EXIT_FAILURE);
+    }
+    trace->is_flush_thread_running = 1;
+  }
+
+  // the background flusher falls behind. With the chunk pool, the full
+  //   chunks are only bounded by the flush queue
+  while ((p_buffer->nb_spare_buffers == 0 && !trace->chunk_size)
+      || trace->flush_queue_count == trace->flush_queue_depth) {
+    if (trace->flush_policy == LITL_FLUSH_POLICY_DROP) {
+      trace->nb_dropped_events++;
+      pthread_mutex_unlock(&trace->lock_flush_queue);
+      return -1;
+    }
+    pthread_cond_wait(&trace->flush_done_cond, &trace->lock_flush_queue);
+  }
+
+  // add an event with offset and enqueue the full buffer
+  __litl_write_probe_offset(trace, index);
+  litl_flush_request_t* request = &trace->flush_queue[(trace->flush_queue_head
+      + trace->flush_queue_count) % trace->flush_queue_depth];
+  request->index = index;
+  request->buffer_ptr = p_buffer->buffer_ptr;
+  request->size = __litl_write_get_buffer_size(trace, index);
+  request->numa_node = p_buffer->numa_node;
+  trace->flush_queue_count++;
+  p_buffer->nb_pending_buffers++;
+
+  // continue recording in a spare buffer, or in a new chunk
+  if (trace->chunk_size)
+    p_buffer->buffer_ptr = __litl_write_alloc_buffer_memory(
+	trace, p_buffer->numa_node);
+  else
+    p_buffer->buffer_ptr = p_buffer->spare_buffers[--p_buffer->nb_spare_buffers];
+  p_buffer->buffer = p_buffer->buffer_ptr;
+  __litl_write_numa_migrate(trace, p_buffer);
+
+  pthread_cond_signal(&trace->flush_queue_cond);
+  pthread_mutex_unlock(&trace->lock_flush_queue);
+
+  return 0;
+}
+
+/*
+ * Waits until the background flusher has written all the pending buffers
+ */
+static void __litl_write_stop_flush_thread(litl_write_trace_t* trace) {
+  pthread_mutex_lock(&trace->lock_flush_queue);
+  if (!trace->is_flush_thread_running) {
+    pthread_mutex_unlock(&trace->lock_flush_queue);
+    return;
+  }
+  trace->is_flush_thread_stopping = 1;
+  pthread_cond_signal(&trace->flush_queue_cond);
+  pthread_mutex_unlock(&trace->lock_flush_queue);
+
+  pthread_join(trace->flush_thread, NULL);
+  trace->is_flush_thread_running = 0;
+  free(trace->flush_queue);
+  trace->flush_queue = NULL;
+}
+
+/*
+ * Flight-recorder mode: keeps the full buffer of a thread in its ring and
+ *   continues in a new buffer, or in the oldest one when the ring is full
+ */
+static void __litl_write_rotate_ring(litl_write_trace_t* trace,
+				     litl_write_buffer_t* p_buffer) {
+  litl_buffer_t buffer_ptr = NULL;
+  litl_buffer_t* ring_buffers = NULL;
+  litl_size_t* ring_sizes = NULL;
+  litl_med_size_t pos, ring_capacity = 0;
+
+  if (!p_buffer->ring_buffers) {
+    // the current buffer counts as one of the nb_buffers buffers
+    ring_capacity = trace->nb_buffers - 1;
+    ring_buffers = malloc(ring_capacity * sizeof(litl_buffer_t));
+    ring_sizes = malloc(ring_capacity * sizeof(litl_size_t));
+    if (!ring_buffers || !ring_sizes) {
+      perror("Could not allocate memory for the flight recorder!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (!p_buffer->ring_buffers
+      || p_buffer->nb_ring_buffers < p_buffer->ring_capacity)
+    buffer_ptr = __litl_write_get_numa_buffer(trace, p_buffer->numa_node);
+
+  // the sampling counters are recorded when the chunk is closed
+  p_buffer->buffer += __litl_write_fill_sampling_counters(trace, p_buffer,
+							  p_buffer->buffer, 0);
+
+  // litl_write_dump_ring copies the ring while its owner keeps recording
+  __atomic_store_n(&p_buffer->ring_seq, p_buffer->ring_seq + 1,
+		   __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  if (ring_buffers) {
+    p_buffer->ring_buffers = ring_buffers;
+    p_buffer->ring_sizes = ring_sizes;
+    p_buffer->ring_capacity = ring_capacity;
+    p_buffer->ring_head = 0;
+    p_buffer->nb_ring_buffers = 0;
+  }
+
+  if (buffer_ptr) {
+    pos = (p_buffer->ring_head + p_buffer->nb_ring_buffers)
+      % p_buffer->ring_capacity;
+    p_buffer->nb_ring_buffers++;
+  } else {
+    // overwrite the oldest events
+    pos = p_buffer->ring_head;
+    p_buffer->ring_head = (p_buffer->ring_head + 1) % p_buffer->ring_capacity;
+    buffer_ptr = p_buffer->ring_buffers[pos];
+  }
+  p_buffer->ring_buffers[pos] = p_buffer->buffer_ptr;
+  p_buffer->ring_sizes[pos] = p_buffer->buffer - p_buffer->buffer_ptr;
+  p_buffer->buffer_ptr = buffer_ptr;
+  p_buffer->buffer = buffer_ptr;
+
+  __atomic_store_n(&p_buffer->ring_seq, p_buffer->ring_seq + 1,
+		   __ATOMIC_RELEASE);
+}
+
+/*
+ * Copies the events kept by the flight recorder of a thread to a given
+ *   memory area, which is enlarged if needed. The events are split into
+ *   chunks that end with an offset event, as in a trace file. Returns the
+ *   size of the copy
+ */
+static litl_size_t __litl_write_copy_ring(litl_write_trace_t* trace,
+					  litl_write_buffer_t* p_buffer,
+					  litl_buffer_t* copy,
+					  litl_size_t* copy_length,
+					  litl_offset_t chunk_offset) {
+  litl_med_size_t i, pos, nb_chunks, ring_capacity;
+  litl_size_t size, copy_size, seq;
+  litl_size_t offset_event_size = __litl_get_reg_event_size(1)
+    - __litl_write_get_delta_shift(trace);
+  litl_size_t* sizes = NULL;
+  litl_t* offset_event;
+
+  // the copy is consistent if the owner did not replace any buffer
+  //   meanwhile
+  do {
+    do {
+      seq = __atomic_load_n(&p_buffer->ring_seq, __ATOMIC_ACQUIRE);
+    } while (seq & 1);
+
+    // the full buffers and the current one
+    ring_capacity = p_buffer->ring_capacity;
+    size = (ring_capacity + 1) * __litl_write_get_buffer_length(trace);
+    if (*copy_length < size) {
+      *copy_length = size;
+      *copy = realloc(*copy, *copy_length);
+    }
+    sizes = realloc(sizes, (ring_capacity + 1) * sizeof(litl_size_t));
+    if (!*copy || !sizes) {
+      perror("Could not allocate memory for dumping the flight recorder!");
+      exit(EXIT_FAILURE);
+    }
+
+    // copy the full buffers from the oldest one, then the current one
+    nb_chunks = 0;
+    copy_size = 0;
+    for (i = 0; i <= p_buffer->nb_ring_buffers && i <= ring_capacity; i++) {
+      litl_buffer_t chunk;
+      if (i < p_buffer->nb_ring_buffers) {
+	pos = (p_buffer->ring_head + i) % p_buffer->ring_capacity;
+	chunk = p_buffer->ring_buffers[pos];
+	sizes[nb_chunks] = p_buffer->ring_sizes[pos];
+      } else {
+	chunk = p_buffer->buffer_ptr;
+	sizes[nb_chunks] = __atomic_load_n(&p_buffer->buffer, __ATOMIC_RELAXED)
+	  - chunk;
+      }
+      memcpy(*copy + copy_size, chunk, sizes[nb_chunks]);
+      // the current chunk is still open: add the current sampling counters
+      if (i == p_buffer->nb_ring_buffers)
+	sizes[nb_chunks] += __litl_write_fill_sampling_counters(
+	    trace, p_buffer, *copy + copy_size + sizes[nb_chunks], 1);
+      copy_size += sizes[nb_chunks++] + offset_event_size;
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&p_buffer->ring_seq, __ATOMIC_RELAXED) != seq);
+
+  // terminate each chunk by an offset event to the next one
+  size = 0;
+  for (i = 0; i < nb_chunks; i++) {
+    size += sizes[i];
+    offset_event = __litl_write_fill_event_header(trace, *copy + size, 0,
+						  LITL_OFFSET_CODE,
+						  LITL_TYPE_REGULAR);
+    size += offset_event_size;
+
+    offset_event->parameters.offset.nb_params = 1;
+    offset_event->parameters.offset.offset =
+      (i + 1 < nb_chunks) ? chunk_offset + size : 0;
+  }
+
+  free(sizes);
+  return copy_size;
+}
+
+/*
+ * Writes the events kept by the flight recorder to a trace file
+ */
+void litl_write_dump_ring(litl_write_trace_t* trace, const char* filename) {
+  litl_med_size_t i, nb_threads, nb_dumped_threads;
+  litl_write_buffer_t* p_buffer;
+  litl_offset_t process_header_size, header_size, offset;
+  litl_size_t copy_size, copy_length = 0;
+  litl_buffer_t header, copy = NULL;
+  litl_thread_pair_t* thread_pair;
+  int f_handle;
+
+  if (!trace->allow_ring_buffer) {
+    fprintf(stderr, "[LiTL] Warning: the flight-recorder mode is not activated, %s is not written\n",
+	    filename);
+    return;
+  }
+
+  // the threads keep recording during the dump: __litl_write_copy_ring
+  //   retries when a ring rotates. The parameters of the events that are
+  //   being recorded when their chunk is copied may be missing
+  nb_threads = __atomic_load_n(&trace->nb_threads, __ATOMIC_ACQUIRE);
+  nb_dumped_threads = 0;
+  for (i = 0; i < nb_threads; i++)
+    if (__litl_write_get_registered_buffer(trace, i))
+      nb_dumped_threads++;
 
-  if (!trace->is_header_flushed) {
-    /* flush the header to disk */
-    __litl_write_flush_header(trace);
+  process_header_size = sizeof(litl_general_header_t)
+    + sizeof(litl_process_header_t);
+  header_size = process_header_size
+    + (nb_dumped_threads + 1) * sizeof(litl_thread_pair_t);
+  header = calloc(1, header_size);
+  if (!header) {
+    perror("Could not allocate memory for dumping the flight recorder!");
+    exit(EXIT_FAILURE);
   }
 
-  header_size = sizeof(litl_general_header_t) + sizeof(litl_process_header_t);
-  // handle the situation when some threads start after the header was flushed
-  if (!trace->buffers[index]->already_flushed) {
-    __litl_write_flush_thread_header(trace, index, header_size);
-  } else {
-    __litl_write_update_thread_header(trace, index, header_size);
+  // the dump does not use per-thread files nor compression
+  __litl_write_fill_trace_header(
+      trace, header, nb_dumped_threads,
+      __litl_write_get_process_flags(trace)
+	& ~(LITL_FLAG_PER_THREAD_FILES | LITL_FLAG_COMPRESSED
+	    | LITL_FLAG_FOOTER_INDEX));
+
+  f_handle = __litl_open_new_file(filename);
+
+  // the events of each thread follow the pairs (tid, offset); the last
+  //   pair (0, 0) is already zeroed
+  thread_pair = (litl_thread_pair_t *) (header + process_header_size);
+  offset = header_size;
+  for (i = 0; i < nb_threads && nb_dumped_threads > 0; i++) {
+    p_buffer = __litl_write_get_registered_buffer(trace, i);
+    if (!p_buffer)
+      continue;
+    nb_dumped_threads--;
+
+    copy_size = __litl_write_copy_ring(trace, p_buffer, &copy, &copy_length,
+				       offset - process_header_size);
+    thread_pair->tid = p_buffer->tid;
+    thread_pair->offset = offset - process_header_size;
+    thread_pair++;
+
+    if (pwrite(f_handle, copy, copy_size, offset) == -1) {
+      perror("Could not write the flight recorder to the trace file!");
+      exit(EXIT_FAILURE);
+    }
+    offset += copy_size;
   }
 
-  // add an event with offset
-  __litl_write_probe_offset(trace, index);
-  lseek(trace->f_handle, trace->general_offset, SEEK_SET);
-  if (write(trace->f_handle, trace->buffers[index]->buffer_ptr,
-	    __litl_write_get_buffer_size(trace, index)) == -1) {
-    perror(
-	"Flushing the buffer. Could not write measured data to the trace file!");
+  if (pwrite(f_handle, header, header_size, 0) == -1) {
+    perror("Could not write the header to the trace file!");
     exit(EXIT_FAILURE);
   }
+  close(f_handle);
 
-  // update the general_offset
-  trace->general_offset += __litl_write_get_buffer_size(trace, index);
-  // update the current offset of the thread
-  trace->buffers[index]->offset = trace->general_offset - sizeof(litl_offset_t);
-
-  if (trace->allow_thread_safety)
-    pthread_mutex_unlock(&trace->lock_litl_flush);
-
-  trace->buffers[index]->buffer = trace->buffers[index]->buffer_ptr;
+  free(copy);
+  free(header);
 }
 
 /*
- * Checks whether the trace buffer was allocated. If no, then allocate
- *    the buffer and, for otherwise too, returns the position of
- *    the thread buffer in the array buffer_ptr/buffer.
+ * Chunk pool without buffer flush: keeps the full chunk of a thread until the
+ *   trace is finalized and continues in a new chunk. The thread records at
+ *   most buffer_size Bytes of events, as with its own buffer, so the last
+ *   chunk may be shorter. Returns -1 if there is no room left
  */
-static void __litl_write_allocate_buffer(litl_write_trace_t* trace) {
-  litl_med_size_t* pos;
-
-  // thread safe region
-  pthread_mutex_lock(&trace->lock_buffer_init);
-
-  pos = malloc(sizeof(litl_med_size_t));
-  *pos = trace->nb_threads;
-  int thread_id = *pos;
-  pthread_setspecific(trace->index, pos);
-  trace->nb_threads++;
-
-  if (*pos >= trace->nb_allocated_buffers) {
-    // We need to allocate a bigger array of buffers
-    void* ptr = realloc(
-	trace->buffers,
-	trace->nb_allocated_buffers * 2 * sizeof(litl_write_buffer_t*));
-    if (!ptr) {
-      perror("LiTL failed to reallocate memory for threads!\n");
+static int __litl_write_keep_chunk(litl_write_trace_t* trace,
+				   litl_med_size_t index) {
+  litl_write_buffer_t* p_buffer = __litl_write_get_thread_buffer(trace, index);
+  litl_size_t size = __litl_write_get_buffer_size(trace, index);
+  litl_size_t max_chunks;
+
+  // an event that does not fit in an empty chunk does not fit at all
+  if (size == 0 || p_buffer->full_chunks_size + size >= trace->buffer_size)
+    return -1;
+
+  if (p_buffer->nb_full_chunks % LITL_CHUNKS_PER_SLAB == 0) {
+    max_chunks = p_buffer->nb_full_chunks + LITL_CHUNKS_PER_SLAB;
+    p_buffer->full_chunks = realloc(p_buffer->full_chunks,
+				    max_chunks * sizeof(litl_buffer_t));
+    p_buffer->full_chunk_sizes = realloc(p_buffer->full_chunk_sizes,
+					 max_chunks * sizeof(litl_size_t));
+    if (!p_buffer->full_chunks || !p_buffer->full_chunk_sizes) {
+      perror("Could not allocate memory for the full chunks!");
       exit(EXIT_FAILURE);
     }
+  }
+  p_buffer->full_chunks_size += size;
 
-    trace->buffers = ptr;
-    unsigned i;
-    for (i = trace->nb_allocated_buffers; i < 2 * trace->nb_allocated_buffers;
-	i++) {
-      trace->buffers[i] = malloc(sizeof(litl_write_buffer_t));
-      if (!trace->buffers[i]) {
-	perror("Could not allocate memory for a thread\n!");
-	exit(EXIT_FAILURE);
-      }
-      trace->buffers[i]->already_flushed = 0;
-      trace->buffers[i]->initialized = 0;
-    }
-    trace->nb_allocated_buffers *= 2;
+  // the chunk is closed as if it was flushed
+  __litl_write_probe_offset(trace, index);
+  p_buffer->full_chunks[p_buffer->nb_full_chunks] = p_buffer->buffer_ptr;
+  p_buffer->full_chunk_sizes[p_buffer->nb_full_chunks] =
+    __litl_write_get_buffer_size(trace, index);
+  p_buffer->nb_full_chunks++;
+
+  p_buffer->buffer_ptr = __litl_write_alloc_buffer_memory(trace,
+							  p_buffer->numa_node);
+  p_buffer->buffer = p_buffer->buffer_ptr;
+  if (p_buffer->capacity > trace->buffer_size - p_buffer->full_chunks_size)
+    p_buffer->capacity = trace->buffer_size - p_buffer->full_chunks_size;
+  return 0;
+}
+
+/*
+ * Returns the buffer of the calling thread and its index, or NULL if it
+ *   cannot be allocated
+ */
+static litl_write_buffer_t* __litl_write_get_current_buffer(
+    litl_write_trace_t* trace, litl_med_size_t* index) {
+  litl_write_buffer_t *p_buffer;
+
+  // find the thread buffer: first in the thread-local cache, then using
+  //   the private thread variable
+  if (__litl_write_thread_cache.trace == trace
+      && __litl_write_thread_cache.generation == trace->generation) {
+    *index = __litl_write_thread_cache.index;
+    return __litl_write_thread_cache.buffer;
   }
 
-  trace->buffers[thread_id]->tid = CUR_TID;
-  trace->buffers[thread_id]->already_flushed = 0;
+  litl_write_thread_key_t* key = pthread_getspecific(trace->index);
+  if (!key) {
+    __litl_write_allocate_buffer(trace);
+    key = pthread_getspecific(trace->index);
+    if(!key)
+      return NULL;
+  }
+  *index = key->index;
 
-  pthread_mutex_unlock(&trace->lock_buffer_init);
+  p_buffer = __litl_write_get_registered_buffer(trace, *index);
+  if (!p_buffer)
+    return NULL;
 
-  /* use mmap instead of malloc so that we can use the MAP_POPULATE option
-     that makes sure the page table is populated. This way, the page faults
-     caused by litl are sensibly reduced.
-  */
-#define USE_MMAP
+  __litl_write_thread_cache.trace = trace;
+  __litl_write_thread_cache.generation = trace->generation;
+  __litl_write_thread_cache.index = *index;
+  __litl_write_thread_cache.buffer = p_buffer;
+  return p_buffer;
+}
 
-#ifdef USE_MMAP
-  size_t length = trace->buffer_size + __litl_get_reg_event_size(LITL_MAX_PARAMS) + __litl_get_reg_event_size(1);
+/*
+ * Allocates the buffers of the calling thread before its first event
+ */
+int litl_write_register_thread(litl_write_trace_t* trace) {
+  litl_med_size_t index;
+  litl_write_buffer_t* p_buffer;
 
-  int mmap_flags = MAP_SHARED|MAP_ANONYMOUS;
+  if (!trace || !trace->is_litl_initialized)
+    return -1;
 
-#ifdef MAP_POPULATE
-  /* make sure the pages are in the page table. This should reduce page faults when recording events  */
-  mmap_flags |= MAP_POPULATE;
-#endif
+  p_buffer = __litl_write_get_current_buffer(trace, &index);
+  if (!p_buffer)
+    return -1;
 
-  trace->buffers[thread_id]->buffer_ptr = mmap(NULL,
-					       length,
-					       PROT_READ|PROT_WRITE,
-					       mmap_flags,
-					       -1,
-					       0);
-  if(trace->buffers[thread_id]->buffer_ptr == MAP_FAILED) {
-    perror("mmap");
-  }
+  // the spare buffers of the background flusher are allocated too
+  if (trace->allow_async_flush && trace->allow_buffer_flush
+      && !trace->allow_ring_buffer && !p_buffer->mapped_window)
+    __litl_write_alloc_spare_buffers(trace, p_buffer);
+  return 0;
+}
 
-#ifdef MAP_POPULATE
-  /* touch the first pages */
-  if(length> 1024*1024)
-    length=1024*1024;
-#endif	/* if MAP_POPULATE is not available, touch the whole buffer to avoid future page faults */
-  memset(trace->buffers[thread_id]->buffer_ptr, 0, length);
+/*
+ * Registers a thread created by litl_write_create_thread before it runs its
+ *   function
+ */
+static void* __litl_write_start_thread(void* arg) {
+  litl_write_thread_start_t start = *(litl_write_thread_start_t*) arg;
 
-#else  /* USE_MMAP */
-  size_t length = trace->buffer_size + __litl_get_reg_event_size(LITL_MAX_PARAMS) + __litl_get_reg_event_size(1);
-  trace->buffers[thread_id]->buffer_ptr = malloc(length);
-#endif	/* USE_MMAP */
+  free(arg);
+  litl_write_register_thread(start.trace);
+  return start.start_routine(start.arg);
+}
 
-  if (!trace->buffers[thread_id]->buffer_ptr) {
-    perror("Could not allocate memory buffer for the thread\n!");
-    exit(EXIT_FAILURE);
-  }
+/*
+ * Creates a thread that registers before it runs start_routine
+ */
+int litl_write_create_thread(litl_write_trace_t* trace, pthread_t* thread,
+			     const pthread_attr_t* attr,
+			     void* (*start_routine)(void*), void* arg) {
+  int ret;
+  litl_write_thread_start_t* start;
 
-  // touch the memory so that it is allocated for real (otherwise, this may
-  //    cause performance issues on NUMA machines)
-  memset(trace->buffers[thread_id]->buffer_ptr, 1, 1);
-  trace->buffers[thread_id]->buffer = trace->buffers[thread_id]->buffer_ptr;
+  start = malloc(sizeof(litl_write_thread_start_t));
+  if (!start)
+    return ENOMEM;
+  start->trace = trace;
+  start->start_routine = start_routine;
+  start->arg = arg;
 
-  trace->buffers[thread_id]->initialized = 1;
+  ret = pthread_create(thread, attr, __litl_write_start_thread, start);
+  if (ret != 0)
+    free(start);
+  return ret;
 }
 
 /*
- * For internal use only.
- * Allocates an event
+ * Allocates an event in the buffer of the calling thread
  */
-litl_t* __litl_write_get_event(litl_write_trace_t* trace, litl_type_t type,
-			       litl_code_t code, int param_size) {
+static litl_t* __litl_write_alloc_event(litl_write_trace_t* trace,
+					litl_type_t type, litl_code_t code,
+					int param_size) {
   litl_med_size_t index = 0;
   litl_t*retval = NULL;
   litl_size_t event_size = __litl_get_event_size(type, param_size);
@@ -607,59 +3372,108 @@ litl_t* __litl_write_get_event(litl_write_trace_t* trace, litl_type_t type,
   if (trace && trace->is_litl_initialized && !trace->is_recording_paused
     && !trace->is_buffer_full) {
 
-    // find the thread index
-    litl_med_size_t *p_index = pthread_getspecific(trace->index);
-    if (!p_index) {
-      __litl_write_allocate_buffer(trace);
-      p_index = pthread_getspecific(trace->index);
-      if(!p_index)
-	return NULL;
-    }
-    index = *(litl_med_size_t *) p_index;
-
-    if(trace->buffers[index]->initialized == 0)
+    litl_write_buffer_t *p_buffer = __litl_write_get_current_buffer(trace,
+								    &index);
+    if (!p_buffer)
       return NULL;
 
-    litl_write_buffer_t *p_buffer = trace->buffers[index];
+    litl_size_t used_memory = p_buffer->buffer - p_buffer->buffer_ptr;
+    litl_time_t time = litl_get_time_inline();
+    litl_data_t is_time_sync = 0;
 
-    // is there enough space in the buffer?
-    litl_size_t used_memory= __litl_write_get_buffer_size(trace, index);
+    // with delta-encoded timestamps, the first event of a buffer and the
+    //   events that follow a long interval are preceded by an event that
+    //   stores the full time
+    if (trace->allow_delta_time) {
+      event_size -= LITL_DELTA_SHIFT;
+      if (used_memory == 0
+	  || time - p_buffer->last_time > LITL_TIME_DELTA_MAX) {
+	is_time_sync = 1;
+	event_size += __litl_get_event_size(LITL_TYPE_TIME, 0)
+	  - LITL_DELTA_SHIFT;
+      }
+    }
 
-    if (used_memory+event_size < trace->buffer_size) {
+    // is there enough space in the buffer?
+    if (used_memory+event_size < p_buffer->capacity) {
       // there is enough space for this event
-      litl_t* cur_ptr = (litl_t*) p_buffer->buffer;
+      litl_t* cur_ptr;
+
+      if (is_time_sync) {
+	cur_ptr = __litl_write_fill_event_header(trace, p_buffer->buffer, 0, 0,
+						 LITL_TYPE_TIME);
+	cur_ptr->parameters.time.time = time;
+	p_buffer->buffer += __litl_get_gen_event_size(cur_ptr)
+	  - LITL_DELTA_SHIFT;
+	p_buffer->last_time = time;
+      }
 
       // fill the event
-      cur_ptr->time = litl_get_time();
-      cur_ptr->code = code;
-      cur_ptr->type = type;
+      cur_ptr = __litl_write_fill_event_header(
+	  trace, p_buffer->buffer,
+	  trace->allow_delta_time ? time - p_buffer->last_time : time, code,
+	  type);
+      p_buffer->last_time = time;
 
       switch (type) {
       case LITL_TYPE_REGULAR:
-	cur_ptr->parameters.regular.nb_params = (param_size) / sizeof(litl_param_t);
+	// for regular events, param_size is the number of parameters
+	cur_ptr->parameters.regular.nb_params = param_size;
 	break;
       case LITL_TYPE_RAW:
 	cur_ptr->parameters.raw.size = param_size;
 	break;
       case LITL_TYPE_PACKED:
+      case LITL_TYPE_FRAGMENT:
 	cur_ptr->parameters.packed.size = param_size;
 	break;
       case LITL_TYPE_OFFSET:
 	cur_ptr->parameters.offset.nb_params = param_size;
 	break;
+      case LITL_TYPE_VARINT:
+	// the number of parameters is set by the caller
+	cur_ptr->parameters.varint.size = param_size;
+	break;
+      case LITL_TYPE_STRING:
+	// the id is set by the caller
+	break;
       default:
 	fprintf(stderr, "Unknown event type %d\n", type);
 	abort();
       }
 
-      p_buffer->buffer += __litl_get_gen_event_size(cur_ptr);
+      p_buffer->buffer += __litl_get_gen_event_size(cur_ptr)
+	- __litl_write_get_delta_shift(trace);
 
       retval = cur_ptr;
       goto out;
+    } else if (trace->allow_ring_buffer) {
+      // not enough space. keep the buffer in the ring and continue in the
+      //   oldest one
+      __litl_write_rotate_ring(trace, p_buffer);
+      retval = __litl_write_alloc_event(trace, type, code, param_size);
+      goto out;
     } else if (trace->allow_buffer_flush) {
       // not enough space. flush the buffer and retry
-      __litl_write_flush_buffer(trace, index);
-      retval =  __litl_write_get_event(trace, type, code, param_size);
+      if (p_buffer->mapped_window) {
+	__litl_write_flush_buffer(trace, index);
+	__litl_write_next_mapped_chunk(trace, p_buffer);
+      } else if (trace->allow_async_flush) {
+	if (__litl_write_submit_buffer(trace, index) < 0) {
+	  // no spare buffer available, the event is dropped
+	  retval = NULL;
+	  goto out;
+	}
+      } else {
+	__litl_write_flush_buffer(trace, index);
+	__litl_write_numa_migrate(trace, p_buffer);
+      }
+      retval =  __litl_write_alloc_event(trace, type, code, param_size);
+      goto out;
+    } else if (trace->chunk_size && __litl_write_keep_chunk(trace, index) == 0) {
+      // not enough space in the chunk, but flushing is disabled so keep it
+      //   and retry in a new chunk
+      retval = __litl_write_alloc_event(trace, type, code, param_size);
       goto out;
     } else {
       // not enough space, but flushing is disabled so just stop recording
@@ -673,6 +3487,148 @@ litl_t* __litl_write_get_event(litl_write_trace_t* trace, litl_type_t type,
   return retval;
 }
 
+/*
+ * Decides whether the calling thread records an event whose code is sampled.
+ *   The sampling counters of the thread are recorded when its chunks are
+ *   closed
+ */
+static int __litl_write_sample_event(litl_write_trace_t* trace,
+				     litl_code_t code, litl_size_t event_size,
+				     litl_sampling_state_t** p_state) {
+  litl_med_size_t i, index, nb_rules;
+  litl_write_buffer_t* p_buffer;
+  litl_sampling_state_t* state;
+  litl_sampling_policy_t policy;
+  litl_size_t value;
+  litl_time_t time;
+
+  nb_rules = __atomic_load_n(&trace->nb_sampling_rules, __ATOMIC_ACQUIRE);
+  for (i = 0; i < nb_rules; i++)
+    if (trace->sampling_rules[i].code == code)
+      break;
+  if (i == nb_rules)
+    // the codes from LITL_FILTER_NB_CODES without a rule are not sampled
+    return 1;
+
+  policy = __atomic_load_n(&trace->sampling_rules[i].policy, __ATOMIC_ACQUIRE);
+  value = __atomic_load_n(&trace->sampling_rules[i].value, __ATOMIC_RELAXED);
+  if (policy == LITL_SAMPLING_NONE)
+    return 1;
+
+  if (!trace->is_litl_initialized || trace->is_recording_paused
+      || trace->is_buffer_full)
+    return 0;
+
+  p_buffer = __litl_write_get_current_buffer(trace, &index);
+  if (!p_buffer)
+    return 0;
+
+  if (!p_buffer->sampling) {
+    p_buffer->sampling = calloc(LITL_MAX_SAMPLING_RULES,
+				sizeof(litl_sampling_state_t));
+    if (!p_buffer->sampling) {
+      perror("Could not allocate memory for the sampling states!");
+      exit(EXIT_FAILURE);
+    }
+  }
+  state = &p_buffer->sampling[i];
+
+  switch (policy) {
+  case LITL_SAMPLING_ONE_IN_N:
+    state->period = value;
+    break;
+  case LITL_SAMPLING_MAX_RATE:
+    // a token bucket that holds at most value events and is refilled with
+    //   value events per millisecond. The credit is counted in events x ns
+    time = litl_get_time();
+    if (time - state->window_start >= 1000000)
+      state->window_usage = (uint64_t) value * 1000000;
+    else
+      state->window_usage += (uint64_t) (time - state->window_start) * value;
+    if (state->window_usage > (uint64_t) value * 1000000)
+      state->window_usage = (uint64_t) value * 1000000;
+    state->window_start = time;
+    state->period = 1;
+    if (state->window_usage < 1000000)
+      goto skip;
+    state->window_usage -= 1000000;
+    break;
+  case LITL_SAMPLING_BUDGET:
+    // adapt the sampling period every 10 ms: double it when the events
+    //   exceed the budget, halve it when they use less than half of it
+    time = litl_get_time();
+    if (state->period == 0)
+      state->period = 1;
+    if (time - state->window_start >= 10000000) {
+      uint64_t budget = (uint64_t) value / 100;
+      if (state->window_usage > budget)
+	state->period *= 2;
+      else if (state->window_usage * 2 < budget && state->period > 1)
+	state->period /= 2;
+      state->window_start = time;
+      state->window_usage = 0;
+    }
+    if (state->window_usage + event_size > (uint64_t) value / 100)
+      goto skip;
+    break;
+  default:
+    return 1;
+  }
+
+  // record one event out of period
+  if (state->countdown > 0) {
+    state->countdown--;
+    goto skip;
+  }
+  state->countdown = state->period - 1;
+  if (policy == LITL_SAMPLING_BUDGET)
+    state->window_usage += event_size;
+
+  // the caller updates the counters once the event is in the buffer
+  *p_state = state;
+  return 1;
+
+ skip:
+  state->nb_events++;
+  return 0;
+}
+
+/*
+ * For internal use only.
+ * Allocates an event
+ */
+litl_t* __litl_write_get_event(litl_write_trace_t* trace, litl_type_t type,
+			       litl_code_t code, int param_size) {
+  litl_sampling_state_t* sampling_state = NULL;
+  litl_data_t state;
+  litl_t* retval;
+
+  if (!trace)
+    return NULL;
+
+  // the disabled codes are discarded before reading the time
+  state = litl_write_get_code_state(trace, code);
+  if (__builtin_expect(state != LITL_CODE_ENABLED, 0)) {
+    if (!(state & LITL_CODE_ENABLED))
+      return NULL;
+    if (!__litl_write_sample_event(trace, code,
+				   __litl_get_event_size(type, param_size),
+				   &sampling_state))
+      return NULL;
+  }
+
+  retval = __litl_write_alloc_event(trace, type, code, param_size);
+
+  // the allocation may close the chunk and record the sampling counters,
+  //   which must not include this event yet
+  if (sampling_state) {
+    sampling_state->nb_events++;
+    if (retval)
+      sampling_state->nb_recorded_events++;
+  }
+  return retval;
+}
+
 
 /* Common function for recording a regular event.
  * This function fills all the fiels except for the parameters
@@ -687,6 +3643,36 @@ static litl_t* __litl_write_probe_reg_common(litl_write_trace_t* trace,
   return retval;
 }
 
+/*
+ * Records a regular event whose parameters are encoded with a variable
+ *   length
+ */
+static litl_t* __litl_write_probe_varint(litl_write_trace_t* trace,
+					 litl_code_t code,
+					 litl_data_t nb_params,
+					 litl_param_t params[]) {
+  litl_data_t i;
+  litl_size_t size = 0;
+  litl_buffer_t pos;
+
+  // the disabled codes are discarded before encoding the parameters
+  if (!litl_write_is_code_enabled(trace, code))
+    return NULL;
+
+  for (i = 0; i < nb_params; i++)
+    size += __litl_get_varint_size(params[i]);
+
+  litl_t* cur_ptr = __litl_write_get_event(trace, LITL_TYPE_VARINT, code,
+					   size);
+  if (cur_ptr) {
+    cur_ptr->parameters.varint.nb_params = nb_params;
+    pos = cur_ptr->parameters.varint.param;
+    for (i = 0; i < nb_params; i++)
+      pos = __litl_encode_varint(pos, params[i]);
+  }
+  return cur_ptr;
+}
+
 /*
  * Records a regular event without any arguments
  */
@@ -700,6 +3686,11 @@ litl_t* litl_write_probe_reg_0(litl_write_trace_t* trace, litl_code_t code) {
  */
 litl_t* litl_write_probe_reg_1(litl_write_trace_t* trace, litl_code_t code,
 			       litl_param_t param1) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1 };
+    return __litl_write_probe_varint(trace, code, 1, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 1);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -712,6 +3703,11 @@ litl_t* litl_write_probe_reg_1(litl_write_trace_t* trace, litl_code_t code,
  */
 litl_t* litl_write_probe_reg_2(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param1, litl_param_t param2) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2 };
+    return __litl_write_probe_varint(trace, code, 2, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 2);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -726,6 +3722,11 @@ litl_t* litl_write_probe_reg_2(litl_write_trace_t* trace, litl_code_t code,
 litl_t* litl_write_probe_reg_3(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param1, litl_param_t param2,
 			    litl_param_t param3) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3 };
+    return __litl_write_probe_varint(trace, code, 3, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 3);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -741,6 +3742,11 @@ litl_t* litl_write_probe_reg_3(litl_write_trace_t* trace, litl_code_t code,
 litl_t* litl_write_probe_reg_4(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param1, litl_param_t param2,
 			    litl_param_t param3, litl_param_t param4) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4 };
+    return __litl_write_probe_varint(trace, code, 4, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 4);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -758,6 +3764,11 @@ litl_t* litl_write_probe_reg_5(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param1, litl_param_t param2,
 			    litl_param_t param3, litl_param_t param4,
 			    litl_param_t param5) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5 };
+    return __litl_write_probe_varint(trace, code, 5, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 5);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -776,6 +3787,11 @@ litl_t* litl_write_probe_reg_6(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param1, litl_param_t param2,
 			    litl_param_t param3, litl_param_t param4,
 			    litl_param_t param5, litl_param_t param6) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5, param6 };
+    return __litl_write_probe_varint(trace, code, 6, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 6);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -796,6 +3812,12 @@ litl_t* litl_write_probe_reg_7(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param3, litl_param_t param4,
 			    litl_param_t param5, litl_param_t param6,
 			    litl_param_t param7) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5, param6,
+			       param7 };
+    return __litl_write_probe_varint(trace, code, 7, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 7);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -817,6 +3839,12 @@ litl_t* litl_write_probe_reg_8(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param3, litl_param_t param4,
 			    litl_param_t param5, litl_param_t param6,
 			    litl_param_t param7, litl_param_t param8) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5, param6,
+			      param7, param8 };
+    return __litl_write_probe_varint(trace, code, 8, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 8);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -840,6 +3868,12 @@ litl_t* litl_write_probe_reg_9(litl_write_trace_t* trace, litl_code_t code,
 			    litl_param_t param5, litl_param_t param6,
 			    litl_param_t param7, litl_param_t param8,
 			    litl_param_t param9) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5, param6,
+			      param7, param8, param9 };
+    return __litl_write_probe_varint(trace, code, 9, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 9);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -864,6 +3898,12 @@ litl_t* litl_write_probe_reg_10(litl_write_trace_t* trace, litl_code_t code,
 			     litl_param_t param5, litl_param_t param6,
 			     litl_param_t param7, litl_param_t param8,
 			     litl_param_t param9, litl_param_t param10) {
+  if (trace && trace->allow_varint_params) {
+    litl_param_t params[] = { param1, param2, param3, param4, param5, param6,
+			      param7, param8, param9, param10 };
+    return __litl_write_probe_varint(trace, code, 10, params);
+  }
+
   litl_t *cur_ptr = __litl_write_probe_reg_common(trace, code, 10);
   if(cur_ptr) {
     cur_ptr->parameters.regular.param[0] = param1;
@@ -880,13 +3920,170 @@ litl_t* litl_write_probe_reg_10(litl_write_trace_t* trace, litl_code_t code,
   return cur_ptr;
 }
 
+/*
+ * Returns the largest payload of a packed event that fits in an empty buffer
+ */
+static litl_size_t __litl_write_get_max_payload(litl_write_trace_t* trace) {
+  litl_size_t overhead = __litl_get_event_size(LITL_TYPE_PACKED, 0) + 1;
+
+  // with delta-encoded timestamps, the first event of a buffer is preceded
+  //   by a time synchronization event
+  if (trace->allow_delta_time)
+    overhead += __litl_get_event_size(LITL_TYPE_TIME, 0)
+      - 2 * LITL_DELTA_SHIFT;
+  return __litl_write_get_buffer_capacity(trace) - overhead;
+}
+
+/*
+ * Records a payload (at least 1 Byte) in a packed event, or in fragments
+ *   followed by a packed event if it does not fit in a buffer. Returns the
+ *   packed event, or NULL if a piece of the payload was not recorded
+ */
+static litl_t* __litl_write_record_payload(litl_write_trace_t* trace,
+					   litl_code_t code,
+					   const litl_data_t* data,
+					   litl_size_t size) {
+  litl_size_t pos, length, max_payload;
+  litl_t* retval = NULL;
+
+  max_payload = __litl_write_get_max_payload(trace);
+  for (pos = 0; pos < size; pos += length) {
+    length = size - pos;
+    if (length > max_payload)
+      length = max_payload;
+
+    retval = __litl_write_alloc_event(
+	trace, pos + length < size ? LITL_TYPE_FRAGMENT : LITL_TYPE_PACKED,
+	code, length);
+    if (!retval)
+      break;
+    memcpy(retval->parameters.packed.param, data + pos, length);
+  }
+  return retval;
+}
+
+/*
+ * Returns the hash of a string (FNV-1a), which is never 0
+ */
+static uint32_t __litl_write_hash_string(const litl_data_t* data,
+					 litl_size_t size) {
+  uint32_t hash = 2166136261u;
+  litl_size_t i;
+
+  for (i = 0; i < size; i++)
+    hash = (hash ^ data[i]) * 16777619u;
+  return hash ? hash : 1;
+}
+
+/*
+ * Records the event that adds the string of a slot to the trace
+ */
+static void __litl_write_record_string(litl_write_trace_t* trace,
+				       litl_string_slot_t* slot) {
+  if (__litl_write_record_payload(trace, LITL_STRING_CODE, slot->string,
+				  sizeof(litl_string_id_t) + slot->size))
+    __atomic_store_n(&slot->is_recorded, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Returns the id of a string in the string table. The first thread that
+ *   looks up the string adds it and records it in the trace before the other
+ *   threads get its id. Returns 0 if the string table is full
+ */
+static litl_string_id_t __litl_write_intern_string(litl_write_trace_t* trace,
+						   const litl_data_t* data,
+						   litl_size_t size) {
+  litl_string_slot_t *strings, *slot, *expected = NULL;
+  litl_string_id_t id;
+  uint32_t hash, slot_hash;
+  litl_size_t i, pos;
+
+  strings = __atomic_load_n(&trace->strings, __ATOMIC_ACQUIRE);
+  if (!strings) {
+    strings = calloc(LITL_STRING_TABLE_SIZE, sizeof(litl_string_slot_t));
+    if (!strings) {
+      perror("Could not allocate memory for the string table!");
+      exit(EXIT_FAILURE);
+    }
+    if (!__atomic_compare_exchange_n(&trace->strings, &expected, strings, 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      free(strings);
+      strings = expected;
+    }
+  }
+
+  hash = __litl_write_hash_string(data, size);
+  pos = hash % LITL_STRING_TABLE_SIZE;
+  for (i = 0; i < LITL_STRING_TABLE_SIZE;
+       i++, pos = (pos + 1) % LITL_STRING_TABLE_SIZE) {
+    slot = &strings[pos];
+    slot_hash = __atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE);
+
+    if (slot_hash == 0) {
+      if (__atomic_load_n(&trace->nb_strings, __ATOMIC_RELAXED)
+	  >= LITL_STRING_TABLE_SIZE / 2)
+	return 0;
+      if (__atomic_compare_exchange_n(&slot->hash, &slot_hash, hash, 0,
+				      __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+	// this thread adds the string
+	id = __atomic_add_fetch(&trace->nb_strings, 1, __ATOMIC_RELAXED);
+	slot->string = malloc(sizeof(litl_string_id_t) + size);
+	if (!slot->string) {
+	  perror("Could not allocate memory for a string of the string table!");
+	  exit(EXIT_FAILURE);
+	}
+	memcpy(slot->string, &id, sizeof(litl_string_id_t));
+	memcpy(slot->string + sizeof(litl_string_id_t), data, size);
+	slot->size = size;
+	__litl_write_record_string(trace, slot);
+	__atomic_store_n(&slot->id, id, __ATOMIC_RELEASE);
+	return id;
+      }
+      // another thread took the slot
+    }
+    if (slot_hash != hash)
+      continue;
+
+    // the other thread is still adding the string: the event keeps its data
+    //   rather than waiting
+    id = __atomic_load_n(&slot->id, __ATOMIC_ACQUIRE);
+    if (!id)
+      return 0;
+    if (slot->size == size
+	&& memcmp(slot->string + sizeof(litl_string_id_t), data, size) == 0) {
+      // the string was not recorded, e.g. while the recording was paused
+      if (!__atomic_load_n(&slot->is_recorded, __ATOMIC_RELAXED))
+	__litl_write_record_string(trace, slot);
+      return id;
+    }
+  }
+  return 0;
+}
+
 /*
  * Records an event in a raw state, where the size is #args in the void* array.
  * That helps to discover places where the application has crashed
  */
 litl_t* litl_write_probe_raw(litl_write_trace_t* trace, litl_code_t code,
 			  litl_size_t size, litl_data_t data[]) {
-  litl_t* retval = __litl_write_get_event(trace,
+  litl_string_id_t id;
+  litl_t* retval;
+
+  // with the string table, the event carries the id of its data
+  if (trace && __litl_write_has_string_table(trace)) {
+    if (!litl_write_is_code_enabled(trace, code)
+	|| !trace->is_litl_initialized)
+      return NULL;
+    id = __litl_write_intern_string(trace, data, size);
+    if (id) {
+      retval = __litl_write_get_event(trace, LITL_TYPE_STRING, code, 0);
+      if (retval)
+	retval->parameters.string.id = id;
+      return retval;
+    }
+  }
+
+  retval = __litl_write_get_event(trace,
 					  LITL_TYPE_RAW,
 					  code,
 					  size+1);
@@ -900,40 +4097,275 @@ litl_t* litl_write_probe_raw(litl_write_trace_t* trace, litl_code_t code,
   return retval;
 }
 
+/*
+ * Reserves a packed event whose payload is written by the caller. A payload
+ *   that does not fit in a buffer is written to the staging region, and
+ *   copied into fragments when it is committed
+ */
+void* litl_write_reserve(litl_write_trace_t* trace, litl_code_t code,
+			 litl_size_t size) {
+  litl_sampling_state_t* sampling_state = NULL;
+  litl_write_buffer_t* p_buffer;
+  litl_med_size_t index;
+  litl_data_t state;
+  litl_t* event;
+
+  if (!trace || !trace->is_litl_initialized)
+    return NULL;
+
+  // the disabled codes are discarded before looking for the thread buffer
+  state = litl_write_get_code_state(trace, code);
+  if (!(state & LITL_CODE_ENABLED))
+    return NULL;
+
+  p_buffer = __litl_write_get_current_buffer(trace, &index);
+  if (!p_buffer)
+    return NULL;
+
+  // a reservation that was not committed is committed now
+  if (p_buffer->reserved_event || p_buffer->reserved_data)
+    litl_write_commit(trace);
+
+  if (size <= __litl_write_get_max_payload(trace)) {
+    event = __litl_write_get_event(trace, LITL_TYPE_PACKED, code, size);
+    if (!event)
+      return NULL;
+    p_buffer->reserved_event = event;
+    return event->parameters.packed.param;
+  }
+
+  if (trace->is_recording_paused || trace->is_buffer_full)
+    return NULL;
+  if (state != LITL_CODE_ENABLED
+      && !__litl_write_sample_event(trace, code, size, &sampling_state))
+    return NULL;
+
+  if (p_buffer->staging_size < size) {
+    free(p_buffer->staging);
+    p_buffer->staging = malloc(size);
+    if (!p_buffer->staging) {
+      perror("Could not allocate memory for the reserved payload!");
+      exit(EXIT_FAILURE);
+    }
+    p_buffer->staging_size = size;
+  }
+  p_buffer->reserved_data = p_buffer->staging;
+  p_buffer->reserved_size = size;
+  p_buffer->reserved_code = code;
+  p_buffer->reserved_sampling = sampling_state;
+  return p_buffer->reserved_data;
+}
+
+/*
+ * Commits the event reserved by the calling thread. A payload larger than a
+ *   buffer is split into fragments, and the last piece is a packed event
+ */
+litl_t* litl_write_commit(litl_write_trace_t* trace) {
+  litl_write_buffer_t* p_buffer;
+  litl_med_size_t index;
+  litl_t* retval;
+
+  if (!trace || !trace->is_litl_initialized)
+    return NULL;
+
+  p_buffer = __litl_write_get_current_buffer(trace, &index);
+  if (!p_buffer)
+    return NULL;
+
+  // the reserved event is already in the buffer
+  if (p_buffer->reserved_event) {
+    retval = p_buffer->reserved_event;
+    p_buffer->reserved_event = NULL;
+    return retval;
+  }
+  if (!p_buffer->reserved_data)
+    return NULL;
+
+  // the fragments bypass the sampling, which was decided by the reservation
+  retval = __litl_write_record_payload(trace, p_buffer->reserved_code,
+				       p_buffer->reserved_data,
+				       p_buffer->reserved_size);
+
+  // the fragments may close chunks and record the sampling counters, which
+  //   must not include this event yet
+  if (p_buffer->reserved_sampling) {
+    p_buffer->reserved_sampling->nb_events++;
+    if (retval)
+      p_buffer->reserved_sampling->nb_recorded_events++;
+  }
+  p_buffer->reserved_data = NULL;
+  p_buffer->reserved_sampling = NULL;
+  return retval;
+}
+
 /*
  * This function finalizes the trace
  */
 void litl_write_finalize_trace(litl_write_trace_t* trace) {
   litl_med_size_t i;
+  litl_size_t j;
+  litl_write_buffer_t* p_buffer;
+  litl_write_thread_key_t* key;
   if(!trace)
     return;
 
-  for (i = 0; i < trace->nb_threads; i++) {
-    __litl_write_flush_buffer(trace, i);
+  // the threads that exit from now on keep their buffers
+  key = pthread_getspecific(trace->index);
+  pthread_setspecific(trace->index, NULL);
+  free(key);
+  pthread_key_delete(trace->index);
+
+  // write the pending buffers before the current ones
+  __litl_write_stop_flush_thread(trace);
+  if (trace->nb_dropped_events)
+    fprintf(stderr,
+	    "[LiTL] Warning: %"PRTIu64" events were dropped because the background flusher fell behind\n",
+	    (litl_trace_size_t) trace->nb_dropped_events);
+
+  if (trace->allow_ring_buffer) {
+    // nothing was written so far: save the content of the rings
+    litl_write_dump_ring(trace, trace->filename);
+  } else {
+    for (i = 0; i < trace->nb_threads; i++) {
+      p_buffer = __litl_write_get_registered_buffer(trace, i);
+      if (p_buffer) {
+	// the chunks kept while the buffer flush was disabled come first. The
+	//   last one ends the thread if the current chunk is empty
+	for (j = 0; j < p_buffer->nb_full_chunks; j++)
+	  __litl_write_flush_data(trace, i, p_buffer->full_chunks[j],
+				  p_buffer->full_chunk_sizes[j]);
+	if (p_buffer->nb_full_chunks == 0
+	    || p_buffer->buffer != p_buffer->buffer_ptr)
+	  __litl_write_flush_buffer(trace, i);
+      }
+    }
+  }
+
+  if (trace->allow_per_thread_files && !trace->allow_ring_buffer) {
+    // the main trace file only lists the threads, their events are stored
+    //   in <filename>.<index>. The flight recorder writes a single file
+    for (i = 0; i < trace->nb_threads; i++) {
+      p_buffer = __litl_write_get_registered_buffer(trace, i);
+      if (p_buffer) {
+	close(p_buffer->f_handle);
+	p_buffer->f_handle = -1;
+      }
+    }
+    __litl_write_flush_header(trace);
+  }
+
+  // the footer index lists all the chunks
+  if (__litl_write_has_footer_index(trace) && !trace->allow_ring_buffer) {
+    pthread_mutex_lock(&trace->lock_footer);
+    if (trace->nb_unsaved_chunks > 0)
+      __litl_write_flush_footer(trace);
+    pthread_mutex_unlock(&trace->lock_footer);
   }
 
   close(trace->f_handle);
   trace->f_handle = -1;
+  if (trace->f_direct_handle >= 0)
+    close(trace->f_direct_handle);
+  trace->f_direct_handle = -1;
 
-  for (i = 0; i < trace->nb_allocated_buffers; i++) {
-    if (trace->buffers[i]->tid != 0) {
-      size_t length = trace->buffer_size + __litl_get_reg_event_size(LITL_MAX_PARAMS) + __litl_get_reg_event_size(1);
-#ifdef USE_MMAP
-      int ret = munmap(trace->buffers[i]->buffer_ptr, length);
-      assert(ret==0);
-#else
-      free(trace->buffers[i]->buffer_ptr);
-#endif
-      trace->buffers[i]->buffer_ptr = NULL;
-    } else {
-      break;
+  for (i = 0; i < trace->nb_threads; i++) {
+    p_buffer = __litl_write_get_registered_buffer(trace, i);
+    if (p_buffer) {
+      if (p_buffer->mapped_window)
+	__litl_write_unmap_window(trace, p_buffer);
+      else
+	__litl_write_free_buffer_memory(trace, p_buffer->buffer_ptr);
+      p_buffer->buffer_ptr = NULL;
+
+      while (p_buffer->nb_spare_buffers > 0)
+	__litl_write_free_buffer_memory(
+	    trace, p_buffer->spare_buffers[--p_buffer->nb_spare_buffers]);
+      free(p_buffer->spare_buffers);
+      p_buffer->spare_buffers = NULL;
+
+      while (p_buffer->nb_ring_buffers > 0) {
+	p_buffer->nb_ring_buffers--;
+	__litl_write_free_buffer_memory(
+	    trace,
+	    p_buffer->ring_buffers[(p_buffer->ring_head
+		+ p_buffer->nb_ring_buffers) % p_buffer->ring_capacity]);
+      }
+      free(p_buffer->ring_buffers);
+      free(p_buffer->ring_sizes);
+      p_buffer->ring_buffers = NULL;
+      p_buffer->ring_sizes = NULL;
+
+      while (p_buffer->nb_full_chunks > 0)
+	__litl_write_free_buffer_memory(
+	    trace, p_buffer->full_chunks[--p_buffer->nb_full_chunks]);
+      free(p_buffer->full_chunks);
+      free(p_buffer->full_chunk_sizes);
+      p_buffer->full_chunks = NULL;
+      p_buffer->full_chunk_sizes = NULL;
+
+      free(p_buffer->block_ptr);
+      p_buffer->block_ptr = NULL;
+      free(p_buffer->sampling);
+      p_buffer->sampling = NULL;
+      free(p_buffer->staging);
+      p_buffer->staging = NULL;
+      __litl_write_release_uring(p_buffer);
     }
   }
 
+  for (i = 0; i < LITL_NB_BUFFER_SEGMENTS; i++)
+    free(trace->buffer_segments[i]);
+
+  while (trace->nb_prealloc_buffers > 0)
+    __litl_write_unmap_memory(
+	trace, trace->prealloc_buffers[--trace->nb_prealloc_buffers],
+	trace->prealloc_length);
+  free(trace->prealloc_buffers);
+  trace->prealloc_buffers = NULL;
+  trace->prealloc_size = 0;
+
+  for (i = 0; i < LITL_MAX_NUMA_NODES; i++) {
+    while (trace->numa_pools[i].nb_buffers > 0)
+      __litl_write_free_buffer_memory(
+	  trace,
+	  trace->numa_pools[i].buffers[--trace->numa_pools[i].nb_buffers]);
+    free(trace->numa_pools[i].buffers);
+    trace->numa_pools[i].buffers = NULL;
+  }
+
+  // all the chunks are back in the pool
+  for (j = 0; j < trace->nb_chunk_slabs; j++)
+    __litl_write_unmap_memory(
+	trace,
+	trace->chunk_slabs[j],
+	__litl_write_get_mapping_length(
+	    trace, LITL_CHUNKS_PER_SLAB * __litl_write_get_chunk_length(trace)));
+  free(trace->chunk_slabs);
+  trace->chunk_slabs = NULL;
+  trace->chunk_pool = NULL;
+
   if (trace->allow_thread_safety) {
     pthread_mutex_destroy(&trace->lock_litl_flush);
   }
-  pthread_mutex_destroy(&trace->lock_buffer_init);
+  pthread_mutex_destroy(&trace->lock_flush_queue);
+  pthread_cond_destroy(&trace->flush_queue_cond);
+  pthread_cond_destroy(&trace->flush_done_cond);
+  pthread_mutex_destroy(&trace->lock_numa_pools);
+  pthread_mutex_destroy(&trace->lock_chunk_pool);
+  pthread_mutex_destroy(&trace->lock_free_slots);
+  free(trace->free_slots);
+  trace->free_slots = NULL;
+  for (j = 0; j < trace->nb_footer_threads; j++)
+    free(trace->footer_threads[j].chunks);
+  free(trace->footer_threads);
+  trace->footer_threads = NULL;
+  pthread_mutex_destroy(&trace->lock_footer);
+  if (trace->strings) {
+    for (j = 0; j < LITL_STRING_TABLE_SIZE; j++)
+      free(trace->strings[j].string);
+    free(trace->strings);
+    trace->strings = NULL;
+  }
 
   free(trace->filename);
   trace->filename = NULL;
@@ -18,7 +18,11 @@
 #ifndef LITL_WRITE_H_
 #define LITL_WRITE_H_
 
+#include <string.h>
+
 #include "litl_types.h"
+#include "litl_timer.h"
+#include "litl_codec.h"
 
 /**
  * \defgroup litl_write LiTL Writing Functions
@@ -44,6 +48,11 @@
  * \ingroup litl_write
  */
 
+/**
+ * \defgroup litl_write_inline Inline Functions for Recording Events
+ * \ingroup litl_write
+ */
+
 /**
  * \ingroup litl_write_init
  * \brief Initializes the trace buffer
@@ -55,7 +64,9 @@ litl_write_trace_t* litl_write_init_trace(const uint32_t buf_size);
 
 /**
  * \ingroup litl_write_init
- * \brief Enable buffer flush. By default, it is disabled
+ * \brief Enable buffer flush. By default, it is disabled. When buffer flush
+ *  is enabled, the buffer of a thread that exits is flushed and reused by the
+ *  next thread, except in the flight-recorder mode and with per-thread files
  * \param trace A pointer to the event recording object
  */
 void litl_write_buffer_flush_on(litl_write_trace_t* trace);
@@ -94,6 +105,332 @@ void litl_write_tid_recording_on(litl_write_trace_t* trace);
  */
 void litl_write_tid_recording_off(litl_write_trace_t* trace);
 
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the background flusher: full buffers are handed over to a
+ *  dedicated thread that writes them while the recording thread continues in
+ *  a spare buffer. It only applies when buffer flush is enabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_async_flush_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the background flusher. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_async_flush_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the number of buffers per thread used with the background
+ *  flusher. By default, each thread uses 2 buffers
+ * \param trace A pointer to the event recording object
+ * \param nb_buffers A number of buffers per thread (at least 2)
+ */
+void litl_write_set_nb_buffers(litl_write_trace_t* trace,
+			       litl_med_size_t nb_buffers);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the maximum number of full buffers waiting to be written by the
+ *  background flusher. By default, it is 16. It has to be set before the
+ *  first buffer is flushed
+ * \param trace A pointer to the event recording object
+ * \param depth A maximum number of pending buffers
+ */
+void litl_write_set_flush_queue_depth(litl_write_trace_t* trace,
+				      litl_med_size_t depth);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Selects the behavior of recording threads when the background flusher
+ *  falls behind: either wait for a buffer to be released or drop the events.
+ *  By default, threads wait
+ * \param trace A pointer to the event recording object
+ * \param policy The policy to apply
+ */
+void litl_write_set_flush_policy(litl_write_trace_t* trace,
+				 litl_flush_policy_t policy);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the NUMA placement: the buffers of each thread are bound to
+ *  the NUMA node the thread runs on. A thread that moved to another node gets
+ *  buffers of its new node at its next flush. It has to be called before the
+ *  first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_numa_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the NUMA placement. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_numa_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the number of buffers kept in the pool of each NUMA node. The
+ *  pools are filled when the first thread starts and provide ready buffers to
+ *  the threads that start or migrate on the node; the buffers left by the
+ *  threads that migrated return to them. By default, there is no pool. It
+ *  only applies with the NUMA placement and has to be called before the first
+ *  event is recorded
+ * \param trace A pointer to the event recording object
+ * \param pool_size A number of buffers per NUMA node
+ */
+void litl_write_set_numa_pool_size(litl_write_trace_t* trace,
+				   litl_med_size_t pool_size);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the size of the chunks of the shared pool: instead of a buffer
+ *  of buffer_size Bytes, each thread records its events in a chunk of the
+ *  pool and takes a new one when it is full, so the memory follows the number
+ *  of events rather than the number of threads. Full chunks are flushed and
+ *  go back to the pool. When the buffer flush is disabled, each thread keeps
+ *  its full chunks until the trace is finalized, up to buffer_size Bytes. The
+ *  chunks are not bound to NUMA nodes. By default, the chunk size is 0, i.e.
+ *  each thread has its own buffer. It has to be called before the first
+ *  event is recorded
+ * \param trace A pointer to the event recording object
+ * \param chunk_size A size of chunks (at most the buffer size), or 0
+ */
+void litl_write_set_chunk_size(litl_write_trace_t* trace,
+			       litl_size_t chunk_size);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Selects the kind of pages that back the buffers: huge pages reduce
+ *  the TLB misses when recording events and the setup of page tables when
+ *  threads start. Explicit huge pages fall back to transparent ones, which
+ *  fall back to regular pages, when they are not available. By default,
+ *  buffers use regular pages. It has to be called before the first event is
+ *  recorded
+ * \param trace A pointer to the event recording object
+ * \param hugepages The kind of pages to request
+ */
+void litl_write_set_hugepages(litl_write_trace_t* trace,
+			      litl_hugepages_t hugepages);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Returns the kind of pages actually obtained for the buffers
+ * \param trace A pointer to the event recording object
+ * \return The requested kind of pages, or the fallback used by at least one
+ *  buffer
+ */
+litl_hugepages_t litl_write_get_hugepages(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable per-thread trace files: each thread writes its events to its
+ *  own file <filename>.<thread index> without any shared lock. The trace
+ *  file itself only lists the threads and is written when the trace is
+ *  finalized. It has to be called before the first buffer is flushed
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_per_thread_files_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable per-thread trace files. By default, they are disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_per_thread_files_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable delta-encoded timestamps: each event stores the time elapsed
+ *  since the previous event of the thread in 32 bits instead of the full
+ *  time, which shortens every event by 4 Bytes. The reader rebuilds the full
+ *  time. The time field of the events returned by the probes is then not
+ *  meaningful. It has to be called before the first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_delta_time_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable delta-encoded timestamps. By default, they are disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_delta_time_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable variable-length parameters: the regular events with
+ *  parameters are recorded as LITL_TYPE_VARINT events, which store each
+ *  parameter in LEB128, i.e. in 1 Byte for values below 128, 2 Bytes below
+ *  16384, etc. The reader decodes them as regular events. It has to be called
+ *  before the first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_varint_params_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable variable-length parameters. By default, they are disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_varint_params_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the string table: the data of each raw event, e.g. a function
+ *  name or a file path, is recorded once in a string table, and the raw
+ *  events carry its id (LITL_TYPE_STRING). The reader turns them back into
+ *  raw events. It has to be called before the first event is recorded. The
+ *  flight recorder does not use the string table
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_string_table_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the string table. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_string_table_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable direct I/O: the chunks of events are written to the trace
+ *  file with O_DIRECT, so that they do not fill the page cache. The chunks
+ *  are aligned to the page size in memory and in the trace file, and padded
+ *  with zeros up to it. The header and the offsets that link the chunks are
+ *  still written through the page cache. If the file system does not support
+ *  O_DIRECT, a warning is printed and the trace is written through the page
+ *  cache. It has no effect with per-thread files. It has to be called before
+ *  the first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_direct_io_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable direct I/O. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_direct_io_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable io_uring: each chunk of events and the offset that links it
+ *  to the previous chunk of its thread are written with a single io_uring
+ *  submission instead of one pwrite each. Each thread has its own io_uring,
+ *  set up by its first flush, so the threads never share it. Combined with
+ *  the background flusher, the recording threads never wait for the writes.
+ *  If the kernel does not support io_uring or forbids it, a warning is
+ *  printed and the trace is written with pwrite. It has to be called before
+ *  the first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_io_uring_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable io_uring. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_io_uring_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the mapped output: each thread maps LITL_CHUNKS_PER_WINDOW
+ *  chunks of the trace file at once and records its events directly in
+ *  them. Flushing a chunk only links it to the previous chunk of the thread,
+ *  without copying it. The chunks are aligned to the page size in the trace
+ *  file. It has no effect with per-thread files, the flight-recorder mode,
+ *  the background flusher, direct I/O, compression, the shared pool of
+ *  chunks or huge pages. It has to be called before the first event is
+ *  recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_mapped_output_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the mapped output. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_mapped_output_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the footer index: each chunk of events is appended to the
+ *  trace file with a single write, and the threads and the offsets of their
+ *  chunks are kept in memory. They are written as a footer index when the
+ *  trace is finalized and at the checkpoints, instead of patching the header
+ *  and the previous chunk of the thread at each flush. It has no effect with
+ *  per-thread files. It has to be called before the first event is recorded
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_footer_index_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the footer index. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_footer_index_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the number of chunks written between two checkpoints of the
+ *  footer index. At each checkpoint, the footer index is written after the
+ *  chunks and the header points to it, so that a trace whose recording is
+ *  interrupted can be read up to its last checkpoint. By default, it is 256
+ * \param trace A pointer to the event recording object
+ * \param nb_chunks A number of chunks, or 0 to write the footer index only
+ *  when the trace is finalized
+ */
+void litl_write_set_footer_checkpoint(litl_write_trace_t* trace,
+				      litl_size_t nb_chunks);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Selects the codec that compresses each chunk of events before it is
+ *  written. The chunks that do not compress are stored as they are. With the
+ *  background flusher, the compression is done by the flushing thread. It has
+ *  to be called before the first event is recorded
+ * \param trace A pointer to the event recording object
+ * \param codec A pointer to the codec (e.g. &litl_codec_lz), or NULL to
+ *  disable the compression. By default, chunks are not compressed
+ */
+void litl_write_set_codec(litl_write_trace_t* trace,
+			  const litl_codec_t* codec);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Enable the flight-recorder mode: each thread keeps its last events in
+ *  a ring of nb_buffers buffers and overwrites the oldest ones instead of
+ *  writing them to the trace file. The events are only written by
+ *  litl_write_dump_ring and when the trace is finalized, in a single file
+ *  even with per-thread files
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_ring_buffer_on(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disable the flight-recorder mode. By default, it is disabled
+ * \param trace A pointer to the event recording object
+ */
+void litl_write_ring_buffer_off(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Writes the events kept by the flight recorder to a trace file. The
+ *  threads keep recording during the dump, so the parameters of an event
+ *  that another thread is recording at that moment may be missing
+ * \param trace A pointer to the event recording object
+ * \param filename A trace file name
+ */
+void litl_write_dump_ring(litl_write_trace_t* trace, const char* filename);
+
 /**
  * \ingroup litl_write_init
  * \brief Pauses the event recording
@@ -108,6 +445,86 @@ void litl_write_pause_recording(litl_write_trace_t* trace);
  */
 void litl_write_resume_recording(litl_write_trace_t* trace);
 
+/**
+ * \ingroup litl_write_init
+ * \brief Enables the recording of the events whose code is between first and
+ *  last. Codes from LITL_FILTER_NB_CODES share the same state, so enabling
+ *  any of them enables all of them. It can be called at any time
+ * \param trace A pointer to the event recording object
+ * \param first The first code of the range
+ * \param last The last code of the range
+ */
+void litl_write_enable_codes(litl_write_trace_t* trace, litl_code_t first,
+			     litl_code_t last);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Disables the recording of the events whose code is between first and
+ *  last: their probes return NULL before reading the time or touching the
+ *  buffers. Codes from LITL_FILTER_NB_CODES share the same state, so
+ *  disabling any of them disables all of them. It can be called at any time.
+ *  By default, all the codes are enabled
+ * \param trace A pointer to the event recording object
+ * \param first The first code of the range
+ * \param last The last code of the range
+ */
+void litl_write_disable_codes(litl_write_trace_t* trace, litl_code_t first,
+			      litl_code_t last);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the mask of the enabled FxT event classes, which is checked by
+ *  the FUT_PROBE macros of fxt.h. By default, all the classes are enabled
+ * \param trace A pointer to the event recording object
+ * \param keymask A mask of the enabled classes
+ */
+void litl_write_set_keymask(litl_write_trace_t* trace, uint32_t keymask);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Sets the sampling policy of an event code. The policy applies to
+ *  each thread separately, and the threads record their sampling counters in
+ *  LITL_SAMPLING_CODE events so that the number of events can be estimated.
+ *  It can be called at any time, but not concurrently with itself
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param policy A sampling policy, or LITL_SAMPLING_NONE to record all the
+ *  events of the code. By default, all the events are recorded
+ * \param value A parameter of the policy: N for LITL_SAMPLING_ONE_IN_N, a
+ *  number of events per millisecond for LITL_SAMPLING_MAX_RATE, or a number
+ *  of Bytes per second for LITL_SAMPLING_BUDGET
+ * \return Returns -1 if the policy cannot be set. Otherwise, returns 0
+ */
+int litl_write_set_sampling(litl_write_trace_t* trace, litl_code_t code,
+			    litl_sampling_policy_t policy, litl_size_t value);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Returns the state of an event code (LITL_CODE_ENABLED,
+ *  LITL_CODE_SAMPLED). It costs a single load
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \return The state bits of the code
+ */
+static inline litl_data_t litl_write_get_code_state(litl_write_trace_t* trace,
+						    litl_code_t code) {
+  litl_code_t pos = code < LITL_FILTER_NB_CODES ? code : LITL_FILTER_NB_CODES;
+  return (trace->code_filter[pos / 4] >> (pos % 4 * 2)) & 0x3;
+}
+
+/**
+ * \ingroup litl_write_init
+ * \brief Checks whether the events with a given code are recorded (possibly
+ *  sampled). It costs a single load
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \return 1 if the events are recorded, 0 otherwise
+ */
+static inline int litl_write_is_code_enabled(litl_write_trace_t* trace,
+					     litl_code_t code) {
+  return litl_write_get_code_state(trace, code) & LITL_CODE_ENABLED;
+}
+
 /**
  * \ingroup litl_write_init
  * \brief Sets a new name for the trace file
@@ -116,6 +533,45 @@ void litl_write_resume_recording(litl_write_trace_t* trace);
  */
 void litl_write_set_filename(litl_write_trace_t* trace, char* filename);
 
+/**
+ * \ingroup litl_write_init
+ * \brief Allocates the buffers of the calling thread, so that its first event
+ *  does not pay for them. Otherwise, they are allocated by the first event
+ *  that the thread records
+ * \param trace A pointer to the event recording object
+ * \return Returns 0 if the buffers are allocated. Otherwise, returns -1
+ */
+int litl_write_register_thread(litl_write_trace_t* trace);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Creates a thread like pthread_create, which registers with
+ *  litl_write_register_thread before it runs start_routine
+ * \param trace A pointer to the event recording object
+ * \param thread A pointer to the ID of the new thread
+ * \param attr The attributes of the new thread, or NULL
+ * \param start_routine The function that the new thread runs
+ * \param arg The argument of start_routine
+ * \return Returns 0 on success. Otherwise, returns an error number
+ */
+int litl_write_create_thread(litl_write_trace_t* trace, pthread_t* thread,
+			     const pthread_attr_t* attr,
+			     void* (*start_routine)(void*), void* arg);
+
+/**
+ * \ingroup litl_write_init
+ * \brief Allocates and populates the buffers of some threads before they
+ *  register, including their spare buffers with the background flusher. The
+ *  threads take them before allocating new ones, and the buffers of the
+ *  threads that exit go back to them. It has no effect with the shared pool
+ *  of chunks, the mapped output or the NUMA placement, which has its own
+ *  pools. It has to be called once the size of the buffers is set
+ * \param trace A pointer to the event recording object
+ * \param nb_threads A number of threads
+ */
+void litl_write_prealloc_threads(litl_write_trace_t* trace,
+				 litl_med_size_t nb_threads);
+
 /*** Regular events ***/
 
 /**
@@ -306,7 +762,8 @@ litl_t* litl_write_probe_reg_10(litl_write_trace_t* trace, litl_code_t code,
 
 /**
  * \ingroup litl_write_raw
- * \brief Records an event with data in a string format
+ * \brief Records an event with data in a string format. With the string
+ *  table, the event carries the id of the data instead (LITL_TYPE_STRING)
  * \param trace A pointer to the event recording object
  * \param code An event code
  * \param size Size (in Bytes) of the data to store
@@ -316,6 +773,33 @@ litl_t* litl_write_probe_reg_10(litl_write_trace_t* trace, litl_code_t code,
 litl_t* litl_write_probe_raw(litl_write_trace_t* trace, litl_code_t code,
 			     litl_size_t size, litl_data_t data[]);
 
+/**
+ * \ingroup litl_write_pack
+ * \brief Reserves a packed event whose payload is written in place by the
+ *  caller, e.g. to serialize a structure or an array without an intermediate
+ *  copy. The payload is recorded once litl_write_commit is called. Until then,
+ *  the calling thread must not record other events. A payload that does not
+ *  fit in a buffer is written to a separate region and recorded by
+ *  litl_write_commit as LITL_TYPE_FRAGMENT events followed by a packed event
+ *  that holds its end
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param size Size (in Bytes) of the payload
+ * \return A pointer to the payload or NULL if the event is not recorded
+ */
+void* litl_write_reserve(litl_write_trace_t* trace, litl_code_t code,
+			 litl_size_t size);
+
+/**
+ * \ingroup litl_write_pack
+ * \brief Records the event reserved by the calling thread with
+ *  litl_write_reserve
+ * \param trace A pointer to the event recording object
+ * \return A pointer to the event that was recorded (the packed event that
+ *  follows the fragments of a large payload) or NULL in case of error
+ */
+litl_t* litl_write_commit(litl_write_trace_t* trace);
+
 /*** Internal-use macros ***/
 
 /**
@@ -740,6 +1224,529 @@ litl_t* __litl_write_get_event(litl_write_trace_t* trace, litl_type_t type,
     retval = p_evt;							\
   } while(0)
 
+/*** Inline probes ***/
+
+/**
+ * \ingroup litl_write_inline
+ * \brief For internal use only. The thread-local cache of the thread buffer
+ *  of the last trace used by the calling thread
+ */
+extern __thread litl_write_thread_cache_t __litl_write_thread_cache;
+
+/**
+ * \ingroup litl_write_inline
+ * \brief For internal use only. Size of a regular event (in Bytes)
+ * \param nb_params A number of parameters
+ */
+#define __LITL_WRITE_REG_EVENT_SIZE(nb_params)				\
+  (LITL_BASE_SIZE + (nb_params) * sizeof(litl_param_t) + sizeof(litl_data_t))
+
+/**
+ * \ingroup litl_write_inline
+ * \brief For internal use only. Allocates an event in the buffer of the
+ *  calling thread without leaving the caller. When the thread buffer is not
+ *  cached or is full, the event is allocated by __litl_write_get_event
+ * \param trace A pointer to the event recording object
+ * \param type An event type
+ * \param code An event code
+ * \param size The number of parameters (regular events) or the size of the
+ *  data (raw events), as for __litl_write_get_event
+ * \param event_size Size of the event (in Bytes)
+ * \return The allocated event or NULL in case of error
+ */
+static inline __attribute__((always_inline))
+litl_t* __litl_write_inline_get_event(litl_write_trace_t* trace,
+				      litl_type_t type, litl_code_t code,
+				      int size, litl_size_t event_size) {
+  litl_write_buffer_t* p_buffer = __litl_write_thread_cache.buffer;
+  litl_size_t used_memory;
+  litl_time_t time;
+  litl_t* cur_ptr;
+
+  if (trace) {
+    litl_data_t state = litl_write_get_code_state(trace, code);
+    if (__builtin_expect(state != LITL_CODE_ENABLED, 0)) {
+      // the sampled codes are handled by __litl_write_get_event
+      if (!(state & LITL_CODE_ENABLED))
+	return NULL;
+      return __litl_write_get_event(trace, type, code, size);
+    }
+  }
+
+  if (__builtin_expect(!trace || __litl_write_thread_cache.trace != trace
+		       || __litl_write_thread_cache.generation
+			 != trace->generation
+		       || !trace->is_litl_initialized
+		       || trace->is_recording_paused || trace->is_buffer_full,
+		       0))
+    return __litl_write_get_event(trace, type, code, size);
+
+  used_memory = p_buffer->buffer - p_buffer->buffer_ptr;
+  time = litl_get_time_inline();
+
+  if (trace->allow_delta_time) {
+    // the time synchronization events are recorded by __litl_write_get_event
+    if (__builtin_expect(used_memory == 0
+			 || time - p_buffer->last_time > LITL_TIME_DELTA_MAX
+			 || used_memory + event_size - LITL_DELTA_SHIFT
+			   >= p_buffer->capacity, 0))
+      return __litl_write_get_event(trace, type, code, size);
+
+    cur_ptr = (litl_t*) (p_buffer->buffer - LITL_DELTA_SHIFT);
+    *(litl_time_delta_t*) p_buffer->buffer = time - p_buffer->last_time;
+    p_buffer->last_time = time;
+    event_size -= LITL_DELTA_SHIFT;
+  } else {
+    if (__builtin_expect(used_memory + event_size >= p_buffer->capacity, 0))
+      return __litl_write_get_event(trace, type, code, size);
+
+    cur_ptr = (litl_t*) p_buffer->buffer;
+    cur_ptr->time = time;
+  }
+
+  cur_ptr->code = code;
+  cur_ptr->type = type;
+  if (type == LITL_TYPE_REGULAR)
+    cur_ptr->parameters.regular.nb_params = size;
+  else
+    cur_ptr->parameters.raw.size = size;
+
+  p_buffer->buffer += event_size;
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event without any arguments. Same as
+ *  litl_write_probe_reg_0, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_0(
+    litl_write_trace_t* trace, litl_code_t code) {
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 0, __LITL_WRITE_REG_EVENT_SIZE(0));
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with one argument. Same as
+ *  litl_write_probe_reg_1, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_1(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_1(trace, code, param1);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 1, __LITL_WRITE_REG_EVENT_SIZE(1));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 2 arguments. Same as
+ *  litl_write_probe_reg_2, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_2(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_2(trace, code, param1, param2);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 2, __LITL_WRITE_REG_EVENT_SIZE(2));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 3 arguments. Same as
+ *  litl_write_probe_reg_3, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_3(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_3(trace, code, param1, param2, param3);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 3, __LITL_WRITE_REG_EVENT_SIZE(3));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 4 arguments. Same as
+ *  litl_write_probe_reg_4, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_4(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_4(trace, code, param1, param2, param3, param4);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 4, __LITL_WRITE_REG_EVENT_SIZE(4));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 5 arguments. Same as
+ *  litl_write_probe_reg_5, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_5(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_5(trace, code, param1, param2, param3, param4,
+				  param5);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 5, __LITL_WRITE_REG_EVENT_SIZE(5));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 6 arguments. Same as
+ *  litl_write_probe_reg_6, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \param param6 6th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_6(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5,
+    litl_param_t param6) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_6(trace, code, param1, param2, param3, param4,
+				  param5, param6);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 6, __LITL_WRITE_REG_EVENT_SIZE(6));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+    cur_ptr->parameters.regular.param[5] = param6;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 7 arguments. Same as
+ *  litl_write_probe_reg_7, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \param param6 6th parameter for this event
+ * \param param7 7th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_7(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5,
+    litl_param_t param6,
+    litl_param_t param7) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_7(trace, code, param1, param2, param3, param4,
+				  param5, param6, param7);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 7, __LITL_WRITE_REG_EVENT_SIZE(7));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+    cur_ptr->parameters.regular.param[5] = param6;
+    cur_ptr->parameters.regular.param[6] = param7;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 8 arguments. Same as
+ *  litl_write_probe_reg_8, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \param param6 6th parameter for this event
+ * \param param7 7th parameter for this event
+ * \param param8 8th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_8(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5,
+    litl_param_t param6,
+    litl_param_t param7,
+    litl_param_t param8) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_8(trace, code, param1, param2, param3, param4,
+				  param5, param6, param7, param8);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 8, __LITL_WRITE_REG_EVENT_SIZE(8));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+    cur_ptr->parameters.regular.param[5] = param6;
+    cur_ptr->parameters.regular.param[6] = param7;
+    cur_ptr->parameters.regular.param[7] = param8;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 9 arguments. Same as
+ *  litl_write_probe_reg_9, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \param param6 6th parameter for this event
+ * \param param7 7th parameter for this event
+ * \param param8 8th parameter for this event
+ * \param param9 9th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_9(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5,
+    litl_param_t param6,
+    litl_param_t param7,
+    litl_param_t param8,
+    litl_param_t param9) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_9(trace, code, param1, param2, param3, param4,
+				  param5, param6, param7, param8, param9);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 9, __LITL_WRITE_REG_EVENT_SIZE(9));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+    cur_ptr->parameters.regular.param[5] = param6;
+    cur_ptr->parameters.regular.param[6] = param7;
+    cur_ptr->parameters.regular.param[7] = param8;
+    cur_ptr->parameters.regular.param[8] = param9;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records a regular event with 10 arguments. Same as
+ *  litl_write_probe_reg_10, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param param1 1st parameter for this event
+ * \param param2 2nd parameter for this event
+ * \param param3 3rd parameter for this event
+ * \param param4 4th parameter for this event
+ * \param param5 5th parameter for this event
+ * \param param6 6th parameter for this event
+ * \param param7 7th parameter for this event
+ * \param param8 8th parameter for this event
+ * \param param9 9th parameter for this event
+ * \param param10 10th parameter for this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_reg_10(
+    litl_write_trace_t* trace, litl_code_t code,
+    litl_param_t param1,
+    litl_param_t param2,
+    litl_param_t param3,
+    litl_param_t param4,
+    litl_param_t param5,
+    litl_param_t param6,
+    litl_param_t param7,
+    litl_param_t param8,
+    litl_param_t param9,
+    litl_param_t param10) {
+  if (trace && trace->allow_varint_params)
+    return litl_write_probe_reg_10(trace, code, param1, param2, param3, param4,
+				   param5, param6, param7, param8, param9,
+				   param10);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_REGULAR, code, 10, __LITL_WRITE_REG_EVENT_SIZE(10));
+  if (cur_ptr) {
+    cur_ptr->parameters.regular.param[0] = param1;
+    cur_ptr->parameters.regular.param[1] = param2;
+    cur_ptr->parameters.regular.param[2] = param3;
+    cur_ptr->parameters.regular.param[3] = param4;
+    cur_ptr->parameters.regular.param[4] = param5;
+    cur_ptr->parameters.regular.param[5] = param6;
+    cur_ptr->parameters.regular.param[6] = param7;
+    cur_ptr->parameters.regular.param[7] = param8;
+    cur_ptr->parameters.regular.param[8] = param9;
+    cur_ptr->parameters.regular.param[9] = param10;
+  }
+  return cur_ptr;
+}
+
+/**
+ * \ingroup litl_write_inline
+ * \brief Records an event with data in a string format. Same as
+ *  litl_write_probe_raw, but inlined in the caller
+ * \param trace A pointer to the event recording object
+ * \param code An event code
+ * \param size Size (in Bytes) of the data to store
+ * \param data Data to store with this event
+ * \return a pointer to the event that was recorded or NULL in case of error
+ */
+static inline litl_t* litl_write_inline_probe_raw(litl_write_trace_t* trace,
+						  litl_code_t code,
+						  litl_size_t size,
+						  litl_data_t data[]) {
+  if (trace && trace->allow_string_table)
+    return litl_write_probe_raw(trace, code, size, data);
+
+  litl_t* cur_ptr = __litl_write_inline_get_event(
+      trace, LITL_TYPE_RAW, code, size + 1,
+      LITL_BASE_SIZE + size + 1 + sizeof(cur_ptr->parameters.raw.size));
+  if (cur_ptr) {
+    memcpy(cur_ptr->parameters.raw.data, data, size);
+    cur_ptr->parameters.raw.data[size] = '\0';
+  }
+  return cur_ptr;
+}
+
+#ifdef LITL_INLINE_PROBES
+/*
+ * Use the inline probes instead of the library functions
+ */
+#define litl_write_probe_reg_0 litl_write_inline_probe_reg_0
+#define litl_write_probe_reg_1 litl_write_inline_probe_reg_1
+#define litl_write_probe_reg_2 litl_write_inline_probe_reg_2
+#define litl_write_probe_reg_3 litl_write_inline_probe_reg_3
+#define litl_write_probe_reg_4 litl_write_inline_probe_reg_4
+#define litl_write_probe_reg_5 litl_write_inline_probe_reg_5
+#define litl_write_probe_reg_6 litl_write_inline_probe_reg_6
+#define litl_write_probe_reg_7 litl_write_inline_probe_reg_7
+#define litl_write_probe_reg_8 litl_write_inline_probe_reg_8
+#define litl_write_probe_reg_9 litl_write_inline_probe_reg_9
+#define litl_write_probe_reg_10 litl_write_inline_probe_reg_10
+#define litl_write_probe_raw litl_write_inline_probe_raw
+#endif /* LITL_INLINE_PROBES */
+
 /**
  * \ingroup litl_write_init
  * \brief Finalizes the trace
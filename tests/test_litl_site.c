@@ -0,0 +1,153 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the probe sites: only the sites of the enabled groups
+ * record events, including while the sites are patched by another thread
+ */
+
+#define _GNU_SOURCE
+#ifdef LITL_TESTBUFFER_FLUSH
+// the sites load their flag instead of being patched
+#define LITL_SITE_NO_PATCH
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+#include "litl_site.h"
+
+#define NBTHREAD 4
+#define NBITER 2000
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records events in the sites of two groups
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++) {
+    LITL_SITE("io", litl_write_probe_reg_1(__trace, 0x100, i));
+    LITL_SITE("mpi", litl_write_probe_reg_2(__trace, 0x200, i, 3));
+  }
+
+  return NULL ;
+}
+
+/*
+ * Records the events of all the threads. The sites of a group are toggled
+ *   while the threads run
+ */
+void record_phase(const char* toggled_group) {
+  int i;
+  pthread_t tid[NBTHREAD];
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  if (toggled_group)
+    for (i = 0; i < 1000; i++) {
+      litl_site_enable_group(toggled_group);
+      litl_site_disable_group(toggled_group);
+    }
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+}
+
+void read_trace(char* filename) {
+  int nb_events[2] = { 0, 0 };
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    switch (LITL_READ_GET_CODE(event)) {
+    case 0x100:
+      nb_events[0]++;
+      break;
+    case 0x200:
+      nb_events[1]++;
+      break;
+    default:
+      fprintf(stderr, "Unexpected event code %"PRTIx32"\n",
+              LITL_READ_GET_CODE(event));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  litl_read_finalize_trace(trace);
+
+  // the "io" sites are enabled in the second and third phases, the "mpi"
+  //   sites in the last one and while they are toggled
+  if (nb_events[0] != 2 * NBTHREAD * NBITER
+      || nb_events[1] < NBTHREAD * NBITER
+      || nb_events[1] > 2 * NBTHREAD * NBITER) {
+    fprintf(stderr, "Unexpected number of events: %d %d\n", nb_events[0],
+            nb_events[1]);
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main() {
+  int res __attribute__ ((__unused__));
+  char* filename;
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads in probe sites\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_site_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_site.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+
+  // all the sites are disabled by default
+  record_phase(NULL);
+
+  if (litl_site_enable_group("io") <= 0) {
+    fprintf(stderr, "Could not enable the probe sites\n");
+    exit(EXIT_FAILURE);
+  }
+  record_phase(NULL);
+
+  record_phase("mpi");
+
+  litl_site_enable_group("mpi");
+  litl_site_disable_group("io");
+  record_phase(NULL);
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
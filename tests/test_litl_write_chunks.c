@@ -0,0 +1,140 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the shared chunk pool: many threads record their events
+ * in small chunks, which are either flushed or kept until the trace is
+ * finalized, and all the events must be read back in order
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 32
+#define NBITER 200
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records events whose parameters are the thread number and the event index
+ */
+void* write_trace(void *arg) {
+  int i;
+  litl_param_t thread_num = *(int*) arg;
+
+  for (i = 0; i < NBITER; i++)
+    if (!litl_write_probe_reg_3(__trace, 0x100, thread_num, i, 3))
+      fprintf(stderr, "Event %d of thread %d was NOT recorded\n", i,
+              (int) thread_num);
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_events = 0;
+  litl_param_t last_index[NBTHREAD];
+  litl_param_t thread_num, index, param;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  for (i = 0; i < NBTHREAD; i++)
+    last_index[i] = (litl_param_t) -1;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    // the events of a thread are read in order, from its successive chunks
+    litl_read_get_param_3(event, thread_num, index, param);
+    if (thread_num >= NBTHREAD || index != last_index[thread_num] + 1
+        || param != 3)
+      goto error;
+    last_index[thread_num] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  int thread_num[NBTHREAD];
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  // each thread holds all its events, but they take several chunks
+  const uint32_t buffer_size = 64 * 1024; // 64KB
+  const uint32_t chunk_size = 1024; // 1KB
+
+  printf("Recording events by %d threads in chunks of %d Bytes\n\n", NBTHREAD,
+         chunk_size);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_chunks_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_chunks.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_set_chunk_size(__trace, chunk_size);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_buffer_flush_on(__trace);
+#else
+  litl_write_buffer_flush_off(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++) {
+    thread_num[i] = i;
+    pthread_create(&tid[i], NULL, write_trace, &thread_num[i]);
+  }
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
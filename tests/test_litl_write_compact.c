@@ -0,0 +1,142 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the compact encodings of events: delta-encoded
+ * timestamps and variable-length parameters. The events read from the trace
+ * must be identical to the recorded ones
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+#include "litl_timer.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records events with small and large parameters. The first parameter is
+ *   the time before the event is recorded
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++) {
+    litl_write_probe_reg_1(__trace, 0x100, litl_get_time());
+    litl_write_probe_reg_3(__trace, 0x101, litl_get_time(), i,
+                           (litl_param_t) -1 - i);
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int nb_events = 0;
+  litl_param_t time, param2, param3;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR)
+      goto error;
+
+    switch (LITL_READ_GET_CODE(event)) {
+    case 0x100:
+      litl_read_get_param_1(event, time);
+      break;
+    case 0x101:
+      litl_read_get_param_3(event, time, param2, param3);
+      if (param3 != (litl_param_t) -1 - param2)
+        goto error;
+      break;
+    default:
+      goto error;
+    }
+
+    // the event is recorded after its first parameter was measured
+    if (LITL_READ_GET_TIME(event) < time)
+      goto error;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * NBITER * 2) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * NBITER * 2, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads with the compact encodings\n\n",
+         NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_compact_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_compact.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_delta_time_on(__trace);
+  litl_write_varint_params_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,159 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the compression of the buffers: the events read from a
+ * compressed trace must be identical to the recorded ones, including the
+ * buffers that do not compress
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+#define NBTHREAD_MAX 64
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records regular events that compress well and raw events that do not
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+  litl_size_t j;
+  // the raw events are terminated by an additional '\0'
+  litl_data_t data[LITL_MAX_DATA - 1];
+  unsigned seed = pthread_self();
+
+  for (i = 0; i < NBITER; i++) {
+    litl_write_probe_reg_2(__trace, 0x100, i, 0x12345678);
+
+    if (i % 64 == 0) {
+      for (j = 0; j < LITL_MAX_DATA - 1; j++)
+        data[j] = rand_r(&seed);
+      data[0] = i;
+      litl_write_probe_raw(__trace, 0x101, sizeof(data), data);
+    }
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_events = 0;
+  litl_tid_t tids[NBTHREAD_MAX];
+  litl_param_t next_params[NBTHREAD_MAX];
+  int nb_tids = 0;
+  litl_param_t param1, param2;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      tids[nb_tids] = LITL_READ_GET_TID(event);
+      next_params[nb_tids] = 0;
+      nb_tids++;
+    }
+
+    switch (LITL_READ_GET_CODE(event)) {
+    case 0x100:
+      litl_read_get_param_2(event, param1, param2);
+      if (param1 != next_params[i] || param2 != 0x12345678)
+        goto error;
+      next_params[i]++;
+      break;
+    case 0x101:
+      // the raw event follows the regular event with the same index
+      if (LITL_READ_RAW(event)->size != LITL_MAX_DATA
+          || (litl_data_t) LITL_READ_RAW(event)->data[0]
+              != (litl_data_t) (next_params[i] - 1))
+        goto error;
+      break;
+    default:
+      goto error;
+    }
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * (NBITER + (NBITER + 63) / 64)) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * (NBITER + (NBITER + 63) / 64), nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 16 * 1024; // 16KB
+
+  printf("Recording events by %d threads with the compression of buffers\n\n",
+         NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_compress_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_compress.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_set_codec(__trace, &litl_codec_lz);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
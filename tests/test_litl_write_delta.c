@@ -0,0 +1,160 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the delta-encoded timestamps: the times rebuilt by the
+ * reader must match the recorded ones across the chunk boundaries, after
+ * intervals that do not fit in a delta, and when the time goes backwards
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+#include "litl_timer.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+
+static litl_write_trace_t* __trace;
+
+// each thread has its own clock, which is set before each event
+static __thread litl_time_t __clock;
+
+static litl_time_t get_time() {
+  return __clock;
+}
+
+/*
+ * Records events whose parameter is their time. The clock mostly moves by
+ *   small steps, but sometimes by the largest delta, by more than it, or
+ *   backwards
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  __clock = 1000000000;
+  for (i = 0; i < NBITER; i++) {
+    if (i % 97 == 96)
+      __clock += (litl_time_t) LITL_TIME_DELTA_MAX + 1 + i;
+    else if (i % 101 == 100)
+      __clock += LITL_TIME_DELTA_MAX;
+    else if (i % 89 == 88)
+      __clock -= 500000;
+    else
+      __clock += 1000 + i % 7;
+
+    litl_write_probe_reg_2(__trace, 0x100, __clock, i);
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_tids = 0, nb_events = 0;
+  litl_tid_t tids[NBTHREAD];
+  litl_param_t last_index[NBTHREAD];
+  litl_param_t time, index;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      if (nb_tids == NBTHREAD)
+        goto error;
+      tids[nb_tids] = LITL_READ_GET_TID(event);
+      last_index[nb_tids++] = (litl_param_t) -1;
+    }
+
+    // the events of a thread are read in order, with their recorded time
+    litl_read_get_param_2(event, time, index);
+    if (index != last_index[i] + 1 || LITL_READ_GET_TIME(event) != time)
+      goto error;
+    last_index[i] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads with delta-encoded timestamps\n\n",
+         NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_delta_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_delta.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_delta_time_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+  litl_set_timing_method(get_time);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
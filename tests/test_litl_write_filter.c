@@ -0,0 +1,144 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the filtering of event codes: the events whose code is
+ * disabled must not be recorded, and the codes can be enabled and disabled
+ * between two phases of the recording
+ */
+
+#define _GNU_SOURCE
+#ifdef LITL_TESTBUFFER_FLUSH
+// the filter is also checked by the inline probes
+#define LITL_INLINE_PROBES
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 2000
+
+static litl_write_trace_t* __trace;
+static litl_data_t __val[] = "Filtered raw event";
+
+/*
+ * Records events with enabled and disabled codes
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++) {
+    litl_write_probe_reg_1(__trace, 0x100, i);
+    litl_write_probe_reg_2(__trace, 0x101, i, 3);
+    litl_write_probe_reg_0(__trace, 0x102);
+    litl_write_probe_reg_1(__trace, 0x20000, i);
+    litl_write_probe_raw(__trace, 0x200, sizeof(__val), __val);
+  }
+
+  return NULL ;
+}
+
+/*
+ * Records the events of all the threads
+ */
+void record_phase() {
+  int i;
+  pthread_t tid[NBTHREAD];
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+}
+
+void read_trace(char* filename) {
+  int nb_events[3] = { 0, 0, 0 };
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    switch (LITL_READ_GET_CODE(event)) {
+    case 0x100:
+    case 0x101:
+    case 0x102:
+      nb_events[LITL_READ_GET_CODE(event) - 0x100]++;
+      break;
+    default:
+      fprintf(stderr, "An event with the disabled code %"PRTIx32" was recorded\n",
+              LITL_READ_GET_CODE(event));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  litl_read_finalize_trace(trace);
+
+  // 0x100 is always enabled, 0x101 only in the second phase and 0x102 only
+  //   in the first one
+  if (nb_events[0] != 2 * NBTHREAD * NBITER
+      || nb_events[1] != NBTHREAD * NBITER
+      || nb_events[2] != NBTHREAD * NBITER) {
+    fprintf(stderr, "Unexpected number of events: %d %d %d\n", nb_events[0],
+            nb_events[1], nb_events[2]);
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main() {
+  int res __attribute__ ((__unused__));
+  char* filename;
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads with filtered codes\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_filter_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_filter.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_disable_codes(__trace, 0x101, 0x101);
+  litl_write_disable_codes(__trace, 0x200, 0x2ff);
+  litl_write_disable_codes(__trace, LITL_FILTER_NB_CODES, (litl_code_t) -1);
+
+  record_phase();
+
+  litl_write_enable_codes(__trace, 0x101, 0x101);
+  litl_write_disable_codes(__trace, 0x102, 0x102);
+
+  record_phase();
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
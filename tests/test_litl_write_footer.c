@@ -0,0 +1,156 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the footer index: the events of threads that start
+ * after the first flush must be read back in order, from the last checkpoint
+ * while the trace is still being recorded, and entirely once it is finalized
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 8
+#define NBITER 2000
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records events whose parameters identify the thread and the event
+ */
+void* write_trace(void *arg) {
+  int i, thread_num = *(int *) arg;
+
+  for (i = 0; i < NBITER; i++)
+    litl_write_probe_reg_2(__trace, 0x100, thread_num, i);
+
+  return NULL ;
+}
+
+/*
+ * Reads the trace and returns the number of events. The events of each
+ *   thread must be read in order, from the first one
+ */
+int read_trace(char* filename) {
+  int nb_events = 0;
+  litl_param_t thread_num, index;
+  litl_param_t last_index[2 * NBTHREAD];
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  memset(last_index, 0xff, sizeof(last_index));
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    litl_read_get_param_2(event, thread_num, index);
+    if (thread_num >= 2 * NBTHREAD || index != last_index[thread_num] + 1)
+      goto error;
+    last_index[thread_num] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+  return nb_events;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * Starts NBTHREAD threads numbered from first and waits for them
+ */
+void run_threads(int first) {
+  int i;
+  pthread_t tid[NBTHREAD];
+  int thread_nums[NBTHREAD];
+
+  for (i = 0; i < NBTHREAD; i++) {
+    thread_nums[i] = first + i;
+    pthread_create(&tid[i], NULL, write_trace, &thread_nums[i]);
+  }
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+}
+
+int main() {
+  int nb_events, res __attribute__ ((__unused__));
+  char* filename;
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads with a footer index\n\n",
+         2 * NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_footer_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_footer.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_footer_index_on(__trace);
+  litl_write_set_footer_checkpoint(__trace, 4);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+
+  run_threads(0);
+
+  // the threads that exited wrote their last chunk, but the last
+  //   checkpoint may not list it
+  printf("Checking the events listed by the last checkpoint\n\n");
+  nb_events = read_trace(filename);
+  if (nb_events == 0 || nb_events > NBTHREAD * NBITER) {
+    fprintf(stderr, "The checkpoint lists %d events out of %d\n", nb_events,
+            NBTHREAD * NBITER);
+    exit(EXIT_FAILURE);
+  }
+
+  run_threads(NBTHREAD);
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  nb_events = read_trace(filename);
+  if (nb_events != 2 * NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        2 * NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
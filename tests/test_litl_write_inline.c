@@ -0,0 +1,171 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the inline probes: the events recorded on the fast
+ * path and the ones that fall back to the library must be identical
+ */
+
+#define _GNU_SOURCE
+#define LITL_INLINE_PROBES
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 3000
+
+static litl_write_trace_t* __trace;
+static litl_data_t __val[] = "Inline raw event";
+
+/*
+ * Records events of every size so that buffers fill up at various positions
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++) {
+    litl_write_probe_reg_0(__trace, 0x100);
+    litl_write_probe_reg_1(__trace, 0x101, i);
+    litl_write_probe_reg_4(__trace, 0x104, i, 3, 5, 7);
+    litl_write_probe_reg_10(__trace, 0x10a, i, 3, 5, 7, 11, 13, 17, 19, 23,
+                            29);
+    litl_write_probe_raw(__trace, 0x200, sizeof(__val), __val);
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_events = 0;
+  litl_tid_t tids[NBTHREAD];
+  litl_param_t expected[NBTHREAD];
+  int nb_tids = 0;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    // the parameters of the events are checked per thread
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      if (nb_tids == NBTHREAD)
+        goto error;
+      tids[nb_tids++] = LITL_READ_GET_TID(event);
+      expected[i] = 0;
+    }
+
+    switch (LITL_READ_GET_CODE(event)) {
+    case 0x100:
+      if (LITL_READ_REGULAR(event)->nb_params != 0)
+        goto error;
+      break;
+    case 0x101:
+      if (LITL_READ_REGULAR(event)->nb_params != 1)
+        goto error;
+      expected[i] = LITL_READ_REGULAR(event)->param[0];
+      break;
+    case 0x104:
+      if (LITL_READ_REGULAR(event)->nb_params != 4
+          || LITL_READ_REGULAR(event)->param[0] != expected[i]
+          || LITL_READ_REGULAR(event)->param[3] != 7)
+        goto error;
+      break;
+    case 0x10a:
+      if (LITL_READ_REGULAR(event)->nb_params != 10
+          || LITL_READ_REGULAR(event)->param[0] != expected[i]
+          || LITL_READ_REGULAR(event)->param[9] != 29)
+        goto error;
+      break;
+    case 0x200:
+      if (LITL_READ_RAW(event)->size != sizeof(__val) + 1
+          || strcmp((char*) LITL_READ_RAW(event)->data, (char*) __val) != 0)
+        goto error;
+      break;
+    default:
+      goto error;
+    }
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * NBITER * 5) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * NBITER * 5, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+#ifdef LITL_TESTBUFFER_FLUSH
+  const uint32_t buffer_size = 1024; // 1KB
+#else
+  const uint32_t buffer_size = 2 * 1024 * 1024; // 2MB
+#endif
+
+  printf("Recording events by %d threads with the inline probes\n\n",
+         NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_inline_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_inline.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_buffer_flush_on(__trace);
+#else
+  litl_write_buffer_flush_off(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
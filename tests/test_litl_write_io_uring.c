@@ -0,0 +1,136 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates io_uring: the chunks and the offsets that link them,
+ * written with io_uring or with pwrite if it is not supported, must be read
+ * back, also with per-thread trace files
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records events whose parameters identify the thread and the event
+ */
+void* write_trace(void *arg) {
+  int i, thread_num = *(int *) arg;
+
+  for (i = 0; i < NBITER; i++)
+    litl_write_probe_reg_2(__trace, 0x100, thread_num, i);
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int nb_events = 0;
+  litl_param_t thread_num, index;
+  litl_param_t last_index[NBTHREAD];
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  memset(last_index, 0xff, sizeof(last_index));
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    // the events of each thread are read in order
+    litl_read_get_param_2(event, thread_num, index);
+    if (thread_num >= NBTHREAD || index != last_index[thread_num] + 1)
+      goto error;
+    last_index[thread_num] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  int thread_nums[NBTHREAD];
+  const uint32_t buffer_size = 16 * 1024; // 16KB
+
+  printf("Recording events by %d threads with io_uring\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_io_uring_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_io_uring.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_io_uring_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+  litl_write_per_thread_files_on(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++) {
+    thread_nums[i] = i;
+    pthread_create(&tid[i], NULL, write_trace, &thread_nums[i]);
+  }
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  // the kernel may not support io_uring
+  if (!__trace->is_io_uring)
+    printf("The trace was written with pwrite\n\n");
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
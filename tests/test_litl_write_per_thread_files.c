@@ -0,0 +1,118 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates per-thread trace files: each thread writes its events
+ * to its own file and the reader gathers them through the main trace file
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 8
+#define NBITER 2000
+
+static litl_write_trace_t* __trace;
+_Atomic int total_recorded_events = 0;
+
+/*
+ * Records events that are flushed to the file of the calling thread
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+  int nb_recorded_events = 0;
+
+  for (i = 0; i < NBITER; i++) {
+    if (litl_write_probe_reg_0(__trace, 0x100 * (i + 1) + 1))
+      nb_recorded_events++;
+    if (litl_write_probe_reg_2(__trace, 0x100 * (i + 1) + 2, i, 3))
+      nb_recorded_events++;
+    if (litl_write_probe_reg_5(__trace, 0x100 * (i + 1) + 3, 1, 3, 5, 7, i))
+      nb_recorded_events++;
+  }
+
+  total_recorded_events += nb_recorded_events;
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int nb_events = 0;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != total_recorded_events) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        total_recorded_events, nb_events);
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads in per-thread files\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_per_thread_files_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_per_thread_files.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_per_thread_files_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_buffer_flush_on(__trace);
+#else
+  litl_write_buffer_flush_off(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
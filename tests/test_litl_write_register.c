@@ -0,0 +1,163 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the registration of threads: the threads created with
+ * litl_write_create_thread and the main thread must take the preallocated
+ * buffers before their first event, and their events must be read back
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+
+static litl_write_trace_t* __trace;
+static pthread_barrier_t __barrier;
+
+/*
+ * Records events whose parameters identify the thread and the event
+ */
+static void record_events(int thread_num) {
+  int i;
+
+  for (i = 0; i < NBITER; i++)
+    litl_write_probe_reg_2(__trace, 0x100, thread_num, i);
+}
+
+/*
+ * Waits until the buffers are checked, before the first event
+ */
+void* write_trace(void *arg) {
+  pthread_barrier_wait(&__barrier);
+  pthread_barrier_wait(&__barrier);
+  record_events(*(int *) arg);
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int nb_events = 0;
+  litl_param_t thread_num, index;
+  litl_param_t last_index[NBTHREAD + 1];
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  memset(last_index, 0xff, sizeof(last_index));
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    // the events of each thread are read in order
+    litl_read_get_param_2(event, thread_num, index);
+    if (thread_num > NBTHREAD || index != last_index[thread_num] + 1)
+      goto error;
+    last_index[thread_num] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != (NBTHREAD + 1) * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        (NBTHREAD + 1) * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  int thread_nums[NBTHREAD];
+  size_t nb_prealloc_buffers, nb_buffers = 1;
+  const uint32_t buffer_size = 16 * 1024; // 16KB
+
+  printf("Registering %d threads before they record events\n\n",
+         NBTHREAD + 1);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_register_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_register.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+  nb_buffers = __trace->nb_buffers;
+#endif
+  litl_write_prealloc_threads(__trace, NBTHREAD + 1);
+  nb_prealloc_buffers = __trace->nb_prealloc_buffers;
+
+  pthread_barrier_init(&__barrier, NULL, NBTHREAD + 1);
+  for (i = 0; i < NBTHREAD; i++) {
+    thread_nums[i] = i;
+    litl_write_create_thread(__trace, &tid[i], NULL, write_trace,
+                             &thread_nums[i]);
+  }
+  litl_write_register_thread(__trace);
+
+  // the options may disable the preallocation
+  pthread_barrier_wait(&__barrier);
+  if (__trace->prealloc_size > 0)
+    nb_prealloc_buffers -= __trace->nb_prealloc_buffers;
+  else
+    nb_prealloc_buffers = (NBTHREAD + 1) * nb_buffers;
+  if (__trace->nb_threads != NBTHREAD + 1
+      || nb_prealloc_buffers != (NBTHREAD + 1) * nb_buffers) {
+    fprintf(stderr, "The threads did not register before their first event\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_barrier_wait(&__barrier);
+
+  record_events(NBTHREAD);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
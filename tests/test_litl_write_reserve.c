@@ -0,0 +1,240 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the reserve/commit API: structures and arrays are
+ * serialized in place, and the payloads larger than a buffer are rebuilt by
+ * the reader from their fragments
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 2000
+#define LARGE_SIZE 5000
+
+#define CODE_STRUCT 0x100
+#define CODE_ARRAY 0x101
+#define CODE_LARGE 0x102
+#define CODE_DISABLED 0x103
+
+typedef struct {
+  uint64_t index;
+  uint32_t value;
+  uint16_t flags;
+} __attribute__((packed)) record_t;
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records a structure, an array of a variable length, and sometimes a payload
+ *   that does not fit in a buffer
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i, j;
+  record_t* record;
+  uint32_t* array;
+  uint8_t* large;
+
+  for (i = 0; i < NBITER; i++) {
+    record = litl_write_reserve(__trace, CODE_STRUCT, sizeof(record_t));
+    if (record) {
+      record->index = i;
+      record->value = i * 3;
+      record->flags = i % 7;
+      litl_write_commit(__trace);
+    }
+
+    array = litl_write_reserve(__trace, CODE_ARRAY,
+                               (i % 50) * sizeof(uint32_t));
+    if (array) {
+      for (j = 0; j < i % 50; j++)
+        array[j] = i + j;
+      litl_write_commit(__trace);
+    }
+
+    if (litl_write_reserve(__trace, CODE_DISABLED, sizeof(record_t))) {
+      fprintf(stderr, "A disabled code was reserved\n");
+      exit(EXIT_FAILURE);
+    }
+
+    if (i % 100 == 0) {
+      large = litl_write_reserve(__trace, CODE_LARGE, LARGE_SIZE);
+      if (large) {
+        for (j = 0; j < LARGE_SIZE; j++)
+          large[j] = (i + j) & 0xff;
+        litl_write_commit(__trace);
+      }
+    }
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, j, nb_tids = 0, nb_events = 0, nb_large = 0;
+  litl_tid_t tids[NBTHREAD];
+  int next_index[NBTHREAD];
+  int next_code[NBTHREAD];
+  uint8_t* payloads[NBTHREAD];
+  litl_size_t payload_sizes[NBTHREAD];
+  record_t record;
+  uint32_t value;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      if (nb_tids == NBTHREAD)
+        goto error;
+      tids[nb_tids] = LITL_READ_GET_TID(event);
+      next_index[nb_tids] = 0;
+      next_code[nb_tids] = CODE_STRUCT;
+      payloads[nb_tids] = malloc(LARGE_SIZE);
+      payload_sizes[nb_tids++] = 0;
+    }
+
+    // the events of a thread are read in order
+    if (LITL_READ_GET_CODE(event) != (litl_code_t) next_code[i])
+      goto error;
+
+    if (LITL_READ_GET_TYPE(event) == LITL_TYPE_FRAGMENT) {
+      if (next_code[i] != CODE_LARGE || payload_sizes[i]
+          + LITL_READ_PACKED(event)->size >= LARGE_SIZE)
+        goto error;
+      memcpy(payloads[i] + payload_sizes[i], LITL_READ_PACKED(event)->param,
+             LITL_READ_PACKED(event)->size);
+      payload_sizes[i] += LITL_READ_PACKED(event)->size;
+      continue;
+    }
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_PACKED)
+      goto error;
+
+    switch (next_code[i]) {
+    case CODE_STRUCT:
+      if (LITL_READ_PACKED(event)->size != sizeof(record_t))
+        goto error;
+      memcpy(&record, LITL_READ_PACKED(event)->param, sizeof(record_t));
+      if (record.index != (uint64_t) next_index[i]
+          || record.value != (uint32_t) next_index[i] * 3
+          || record.flags != next_index[i] % 7)
+        goto error;
+      next_code[i] = CODE_ARRAY;
+      break;
+    case CODE_ARRAY:
+      if (LITL_READ_PACKED(event)->size
+          != (next_index[i] % 50) * sizeof(uint32_t))
+        goto error;
+      for (j = 0; j < next_index[i] % 50; j++) {
+        memcpy(&value, LITL_READ_PACKED(event)->param + j * sizeof(uint32_t),
+               sizeof(uint32_t));
+        if (value != (uint32_t) (next_index[i] + j))
+          goto error;
+      }
+      next_code[i] = next_index[i] % 100 == 0 ? CODE_LARGE : CODE_STRUCT;
+      if (next_code[i] == CODE_STRUCT)
+        next_index[i]++;
+      break;
+    case CODE_LARGE:
+      // the packed event holds the end of the payload
+      if (payload_sizes[i] == 0
+          || payload_sizes[i] + LITL_READ_PACKED(event)->size != LARGE_SIZE)
+        goto error;
+      memcpy(payloads[i] + payload_sizes[i], LITL_READ_PACKED(event)->param,
+             LITL_READ_PACKED(event)->size);
+      for (j = 0; j < LARGE_SIZE; j++)
+        if (payloads[i][j] != ((next_index[i] + j) & 0xff))
+          goto error;
+      payload_sizes[i] = 0;
+      next_code[i] = CODE_STRUCT;
+      next_index[i]++;
+      nb_large++;
+      break;
+    }
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+  for (i = 0; i < nb_tids; i++)
+    free(payloads[i]);
+
+  if (nb_events != NBTHREAD * (2 * NBITER + NBITER / 100)
+      || nb_large != NBTHREAD * NBITER / 100) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBTHREAD * (2 * NBITER + NBITER / 100), nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording reserved events by %d threads\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_reserve_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_reserve.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_disable_codes(__trace, CODE_DISABLED, CODE_DISABLED);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
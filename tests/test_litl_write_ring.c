@@ -0,0 +1,139 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the flight-recorder mode: each thread keeps only its
+ * last events in memory. The dumped trace must contain, for each thread, the
+ * last recorded events without any gap
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records many more events than the ring can store
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++)
+    litl_write_probe_reg_1(__trace, 0x100, i);
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_events = 0;
+  litl_tid_t tids[NBTHREAD];
+  litl_param_t last_params[NBTHREAD];
+  int nb_tids = 0;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+	break;
+    if (i == nb_tids) {
+      tids[nb_tids] = LITL_READ_GET_TID(event);
+      nb_tids++;
+    } else if (LITL_READ_REGULAR(event)->param[0] != last_params[i] + 1) {
+      fprintf(stderr, "The events of thread %"PRTIu64" are not contiguous\n",
+	      (litl_tid_t) tids[i]);
+      exit(EXIT_FAILURE);
+    }
+    last_params[i] = LITL_READ_REGULAR(event)->param[0];
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_tids != NBTHREAD || nb_events == 0
+      || nb_events >= NBTHREAD * NBITER) {
+    fprintf(stderr, "Unexpected content of the flight recorder: %d threads, %d events\n",
+	    nb_tids, nb_events);
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 0; i < nb_tids; i++)
+    if (last_params[i] != NBITER - 1) {
+      fprintf(stderr, "The last events of thread %"PRTIu64" are missing\n",
+	      (litl_tid_t) tids[i]);
+      exit(EXIT_FAILURE);
+    }
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  char* dump_filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads in the flight recorder\n\n",
+	 NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_ring_flush.trace");
+  res = asprintf(&dump_filename, "/tmp/test_litl_write_ring_flush_dump.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_ring.trace");
+  res = asprintf(&dump_filename, "/tmp/test_litl_write_ring_dump.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_ring_buffer_on(__trace);
+  litl_write_set_nb_buffers(__trace, 3);
+#ifdef LITL_TESTBUFFER_FLUSH
+  // the flight recorder never writes the buffers to the trace file
+  litl_write_buffer_flush_on(__trace);
+#endif
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  litl_write_dump_ring(__trace, dump_filename);
+  printf("The last events are stored in %s and %s\n\n", dump_filename,
+	 __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(dump_filename);
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
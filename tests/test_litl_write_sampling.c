@@ -0,0 +1,174 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the sampling of event codes: each thread records the
+ * expected share of the sampled events, and the sampling counters recorded
+ * in the trace are consistent with them
+ */
+
+#define _GNU_SOURCE
+#ifdef LITL_TESTBUFFER_FLUSH
+// the inline probes hand the sampled codes over to the library
+#define LITL_INLINE_PROBES
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 5000
+#define NBCODES 4
+
+static litl_write_trace_t* __trace;
+
+/*
+ * Records the events of the sampled codes 0x100-0x102 and of 0x103
+ */
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+
+  for (i = 0; i < NBITER; i++) {
+    litl_write_probe_reg_1(__trace, 0x100, i);
+    litl_write_probe_reg_1(__trace, 0x101, i);
+    litl_write_probe_reg_1(__trace, 0x102, i);
+    litl_write_probe_reg_1(__trace, 0x103, i);
+  }
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int i, nb_tids = 0;
+  litl_tid_t tids[NBTHREAD];
+  int nb_events[NBTHREAD][NBCODES];
+  litl_param_t reported[NBTHREAD][NBCODES];
+  litl_param_t code, policy, value, nb_seen, nb_recorded;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  memset(nb_events, 0, sizeof(nb_events));
+  memset(reported, 0, sizeof(reported));
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      if (nb_tids == NBTHREAD)
+        goto error;
+      tids[nb_tids++] = LITL_READ_GET_TID(event);
+    }
+
+    if (LITL_READ_GET_CODE(event) == LITL_SAMPLING_CODE) {
+      litl_read_get_param_5(event, code, policy, value, nb_seen,
+                            nb_recorded);
+      if (code < 0x100 || code > 0x102 || nb_recorded > nb_seen
+          || nb_seen > NBITER)
+        goto error;
+      if ((code == 0x100 && (policy != LITL_SAMPLING_ONE_IN_N || value != 10))
+          || (code == 0x101 && (policy != LITL_SAMPLING_MAX_RATE || value != 5))
+          || (code == 0x102
+              && (policy != LITL_SAMPLING_BUDGET || value != 100000)))
+        goto error;
+      // one event out of 10 is recorded, starting with the first one
+      if (code == 0x100 && nb_recorded != (nb_seen - 1) / 10 + 1)
+        goto error;
+      // the counters are recorded at the end of the chunk, after the events
+      if (nb_seen <= reported[i][code - 0x100]
+          || nb_recorded != (litl_param_t) nb_events[i][code - 0x100])
+        goto error;
+      reported[i][code - 0x100] = nb_seen;
+      continue;
+    }
+
+    code = LITL_READ_GET_CODE(event) - 0x100;
+    if (code >= NBCODES)
+      goto error;
+    nb_events[i][code]++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_tids != NBTHREAD)
+    goto error;
+  for (i = 0; i < nb_tids; i++)
+    if (nb_events[i][0] != (NBITER - 1) / 10 + 1
+        || nb_events[i][1] == 0 || nb_events[i][1] >= NBITER
+        || nb_events[i][2] == 0 || nb_events[i][2] >= NBITER
+        || nb_events[i][3] != NBITER
+        // the last counters are recorded when the trace is finalized
+        || reported[i][0] != NBITER || reported[i][1] != NBITER
+        || reported[i][2] != NBITER) {
+      fprintf(stderr, "Unexpected number of events: %d %d %d %d\n",
+              nb_events[i][0], nb_events[i][1], nb_events[i][2],
+              nb_events[i][3]);
+      exit(EXIT_FAILURE);
+    }
+  return;
+
+  error: fprintf(stderr, "Event (code %"PRTIx32") was not recorded correctly\n",
+                 LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d threads with sampled codes\n\n", NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_sampling_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_sampling.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+  litl_write_set_sampling(__trace, 0x100, LITL_SAMPLING_ONE_IN_N, 10);
+  litl_write_set_sampling(__trace, 0x101, LITL_SAMPLING_MAX_RATE, 5);
+  litl_write_set_sampling(__trace, 0x102, LITL_SAMPLING_BUDGET, 100000);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
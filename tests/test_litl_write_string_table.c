@@ -0,0 +1,257 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the string table: the raw events read back must hold
+ * their strings, including a string larger than a buffer and the strings
+ * that do not fit in the table, whether the events are read in the order of
+ * their time or thread by thread. The flight recorder keeps the strings in the
+ * raw events, since it overwrites their definitions
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBITER 10000
+#define NBSTRINGS 4500
+#define LONG_SIZE 3000
+#define NBRING 100000
+
+static litl_write_trace_t* __trace;
+static char __long_string[LONG_SIZE + 1];
+
+/*
+ * Returns the string recorded at iteration i. There are more strings than
+ *   the string table can hold
+ */
+static void get_string(int i, char* str) {
+  if (i % 1000 == 999)
+    strcpy(str, __long_string);
+  else
+    sprintf(str, "function_%d", i % NBSTRINGS);
+}
+
+void* write_trace(void *arg __attribute__ ((__unused__))) {
+  int i;
+  char str[LONG_SIZE + 1];
+
+  for (i = 0; i < NBITER; i++) {
+    get_string(i, str);
+    litl_write_probe_reg_1(__trace, 0x100, i);
+    litl_write_probe_raw(__trace, 0x101, strlen(str), (litl_data_t*) str);
+  }
+
+  return NULL ;
+}
+
+/*
+ * Returns the next event of the trace or, with per_thread, of its threads
+ *   from the last one to the first one
+ */
+static litl_read_event_t* next_event(litl_read_trace_t* trace, int per_thread,
+                                     litl_med_size_t* thread_index) {
+  litl_read_process_t* process = trace->processes[0];
+  litl_read_event_t* event;
+
+  if (!per_thread)
+    return litl_read_next_event(trace);
+
+  for (; *thread_index > 0; (*thread_index)--) {
+    event = litl_read_next_thread_event(trace, process,
+                                        process->threads[*thread_index - 1]);
+    if (event)
+      return event;
+  }
+  return NULL ;
+}
+
+void read_trace(char* filename, int per_thread) {
+  int i, nb_tids = 0, nb_events = 0;
+  litl_med_size_t thread_index;
+  litl_tid_t tids[NBTHREAD + 1];
+  litl_param_t last_index[NBTHREAD + 1];
+  litl_param_t index;
+  char str[LONG_SIZE + 1];
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+  thread_index = trace->processes[0]->nb_threads;
+
+  while (1) {
+    event = next_event(trace, per_thread, &thread_index);
+
+    if (event == NULL )
+      break;
+
+    for (i = 0; i < nb_tids; i++)
+      if (tids[i] == LITL_READ_GET_TID(event))
+        break;
+    if (i == nb_tids) {
+      if (nb_tids == NBTHREAD + 1)
+        goto error;
+      tids[nb_tids] = LITL_READ_GET_TID(event);
+      last_index[nb_tids++] = (litl_param_t) -1;
+    }
+
+    // each regular event is followed by the raw event of the same iteration
+    if (LITL_READ_GET_CODE(event) == 0x100) {
+      if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR)
+        goto error;
+      litl_read_get_param_1(event, index);
+      if (index != last_index[i] + 1)
+        goto error;
+      last_index[i] = index;
+    } else if (LITL_READ_GET_CODE(event) == 0x101) {
+      if (LITL_READ_GET_TYPE(event) != LITL_TYPE_RAW)
+        goto error;
+      get_string(last_index[i], str);
+      if (LITL_READ_RAW(event)->size != strlen(str) + 1
+          || strcmp((char *) LITL_READ_RAW(event)->data, str) != 0)
+        goto error;
+    } else if (LITL_READ_GET_CODE(event) == 0x102) {
+      if (LITL_READ_GET_TYPE(event) != LITL_TYPE_RAW
+          || strcmp((char *) LITL_READ_RAW(event)->data, __long_string) != 0)
+        goto error;
+      continue;
+    } else
+      goto error;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+
+  if (nb_events != 2 * NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        2 * NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+/*
+ * Records the same string before and after the ring has rotated many times:
+ *   the last raw event of the dump must hold the string
+ */
+void check_ring(char* filename, char* dump_filename) {
+  int i, nb_raw = 0;
+  litl_write_trace_t* write_trace;
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  write_trace = litl_write_init_trace(1024);
+  litl_write_set_filename(write_trace, filename);
+  litl_write_ring_buffer_on(write_trace);
+  litl_write_string_table_on(write_trace);
+
+  litl_write_probe_raw(write_trace, 0x101, strlen("hello"),
+                       (litl_data_t*) "hello");
+  for (i = 0; i < NBRING; i++)
+    litl_write_probe_reg_1(write_trace, 0x100, i);
+  litl_write_probe_raw(write_trace, 0x101, strlen("hello"),
+                       (litl_data_t*) "hello");
+
+  litl_write_dump_ring(write_trace, dump_filename);
+  litl_write_finalize_trace(write_trace);
+
+  trace = litl_read_open_trace(dump_filename);
+  litl_read_init_processes(trace);
+  while ((event = litl_read_next_event(trace)) != NULL )
+    if (LITL_READ_GET_CODE(event) == 0x101) {
+      if (LITL_READ_GET_TYPE(event) != LITL_TYPE_RAW
+          || strcmp((char *) LITL_READ_RAW(event)->data, "hello") != 0) {
+        fprintf(stderr, "The string of the flight recorder was not recorded correctly\n");
+        exit(EXIT_FAILURE);
+      }
+      nb_raw++;
+    }
+  litl_read_finalize_trace(trace);
+
+  if (nb_raw != 1) {
+    fprintf(stderr, "The flight recorder kept %d raw events instead of 1\n",
+            nb_raw);
+    exit(EXIT_FAILURE);
+  }
+}
+
+int main() {
+  int i, res __attribute__ ((__unused__));
+  char* filename;
+  char* ring_filename;
+  char* dump_filename;
+  pthread_t tid[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  memset(__long_string, 'x', LONG_SIZE);
+  __long_string[LONG_SIZE] = '\0';
+
+  printf("Recording raw events by %d threads with the string table\n\n",
+         NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_string_table_flush.trace");
+  res = asprintf(&ring_filename,
+                 "/tmp/test_litl_write_string_table_ring_flush.trace");
+  res = asprintf(&dump_filename,
+                 "/tmp/test_litl_write_string_table_ring_flush_dump.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_string_table.trace");
+  res = asprintf(&ring_filename,
+                 "/tmp/test_litl_write_string_table_ring.trace");
+  res = asprintf(&dump_filename,
+                 "/tmp/test_litl_write_string_table_ring_dump.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+  litl_write_string_table_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+
+  // a raw event cannot hold the long string, so the threads must not record
+  //   it while it is being added to the table
+  litl_write_probe_raw(__trace, 0x102, LONG_SIZE, (litl_data_t*) __long_string);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_create(&tid[i], NULL, write_trace, NULL);
+
+  for (i = 0; i < NBTHREAD; i++)
+    pthread_join(tid[i], NULL );
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename, 0);
+  read_trace(filename, 1);
+  check_ring(ring_filename, dump_filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/* -*- c-file-style: "GNU" -*- */
+/*
+ * Copyright © Télécom SudParis.
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * This test validates the recycling of the buffers of the threads that exit:
+ * the events of many short-lived threads must all be read back, while the
+ * number of buffers stays bounded by the number of concurrent threads. Each
+ * thread records its last event from the destructor of another private
+ * thread variable, which runs after its buffer was released
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "litl_types.h"
+#include "litl_write.h"
+#include "litl_read.h"
+
+#define NBTHREAD 4
+#define NBROUND 50
+#define NBITER 300
+
+static litl_write_trace_t* __trace;
+static pthread_key_t __exit_key;
+
+/*
+ * Records the last event of an exiting thread
+ */
+static void exit_trace(void *arg) {
+  litl_write_probe_reg_2(__trace, 0x100, *(int *) arg, NBITER - 1);
+}
+
+/*
+ * Records events whose parameters identify the thread and the event
+ */
+void* write_trace(void *arg) {
+  int i, thread_num = *(int *) arg;
+
+  for (i = 0; i < NBITER - 1; i++)
+    litl_write_probe_reg_2(__trace, 0x100, thread_num, i);
+  pthread_setspecific(__exit_key, arg);
+
+  return NULL ;
+}
+
+void read_trace(char* filename) {
+  int nb_events = 0;
+  litl_param_t thread_num, index;
+  litl_param_t* last_index;
+
+  litl_read_event_t* event;
+  litl_read_trace_t *trace;
+
+  last_index = malloc(NBROUND * NBTHREAD * sizeof(litl_param_t));
+  memset(last_index, 0xff, NBROUND * NBTHREAD * sizeof(litl_param_t));
+
+  trace = litl_read_open_trace(filename);
+
+  litl_read_init_processes(trace);
+
+  while (1) {
+    event = litl_read_next_event(trace);
+
+    if (event == NULL )
+      break;
+
+    if (LITL_READ_GET_TYPE(event) != LITL_TYPE_REGULAR
+        || LITL_READ_GET_CODE(event) != 0x100)
+      goto error;
+
+    // the events of each thread are read in order
+    litl_read_get_param_2(event, thread_num, index);
+    if (thread_num >= NBROUND * NBTHREAD
+        || index != last_index[thread_num] + 1)
+      goto error;
+    last_index[thread_num] = index;
+
+    nb_events++;
+  }
+
+  litl_read_finalize_trace(trace);
+  free(last_index);
+
+  if (nb_events != NBROUND * NBTHREAD * NBITER) {
+    fprintf(
+        stderr,
+        "Some events were NOT recorded!\n Expected nb_events = %d \t Recorded nb_events = %d\n",
+        NBROUND * NBTHREAD * NBITER, nb_events);
+    exit(EXIT_FAILURE);
+  }
+  return;
+
+  error: fprintf(stderr, "Event %d (code %"PRTIx32") was not recorded correctly\n",
+                 nb_events, LITL_READ_GET_CODE(event));
+  exit(EXIT_FAILURE);
+}
+
+int main() {
+  int i, j, res __attribute__ ((__unused__));
+  char* filename;
+  pthread_t tid[NBTHREAD];
+  int thread_nums[NBTHREAD];
+  const uint32_t buffer_size = 1024; // 1KB
+
+  printf("Recording events by %d rounds of %d short-lived threads\n\n",
+         NBROUND, NBTHREAD);
+
+#ifdef LITL_TESTBUFFER_FLUSH
+  res = asprintf(&filename, "/tmp/test_litl_write_thread_exit_flush.trace");
+#else
+  res = asprintf(&filename, "/tmp/test_litl_write_thread_exit.trace");
+#endif
+
+  __trace = litl_write_init_trace(buffer_size);
+  litl_write_set_filename(__trace, filename);
+  litl_write_buffer_flush_on(__trace);
+#ifdef LITL_TESTBUFFER_FLUSH
+  litl_write_async_flush_on(__trace);
+#endif
+  // the destructors of the keys created after the trace run after the one
+  //   that releases the buffers
+  pthread_key_create(&__exit_key, exit_trace);
+
+  for (j = 0; j < NBROUND; j++) {
+    for (i = 0; i < NBTHREAD; i++) {
+      thread_nums[i] = j * NBTHREAD + i;
+      pthread_create(&tid[i], NULL, write_trace, &thread_nums[i]);
+    }
+
+    for (i = 0; i < NBTHREAD; i++)
+      pthread_join(tid[i], NULL );
+  }
+
+  // the exited threads gave their buffers to the next ones
+  if (__trace->nb_threads > NBTHREAD) {
+    fprintf(stderr, "The buffers of the exited threads were not reused: %d buffers for %d threads\n",
+            __trace->nb_threads, NBTHREAD);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("All events are stored in %s\n\n", __trace->filename);
+  litl_write_finalize_trace(__trace);
+
+  printf("Checking the recording of events\n\n");
+
+  read_trace(filename);
+
+  printf("Yes, the events were recorded successfully\n");
+
+  return EXIT_SUCCESS;
+}
@@ -113,6 +113,21 @@ int main(int argc, char **argv) {
       }
       break;
     }
+    case LITL_TYPE_FRAGMENT: { // fragment of a packed event
+      printf("%"PRTIu64" \t%"PRTIu64" \t  Frag   %"PRTIx32" \t %"PRTIu32"\t",
+             LITL_READ_GET_TIME(event), LITL_READ_GET_TID(event),
+             LITL_READ_GET_CODE(event), LITL_READ_PACKED(event)->size);
+      for (i = 0; i < LITL_READ_PACKED(event)->size; i++) {
+        printf(" %x", LITL_READ_PACKED(event)->param[i]);
+      }
+      break;
+    }
+    case LITL_TYPE_STRING: { // raw event whose string was not found
+      printf("%"PRTIu64" \t%"PRTIu64" \t  Str   %"PRTIx32" \t %"PRTIu32,
+             LITL_READ_GET_TIME(event), LITL_READ_GET_TID(event),
+             LITL_READ_GET_CODE(event), LITL_READ_STRING(event)->id);
+      break;
+    }
     case LITL_TYPE_OFFSET: { // offset event
       continue;
     }